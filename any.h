@@ -1,8 +1,16 @@
 #ifndef ANY_H
 #define ANY_H
 
-#include <memory>
+#include "instrumentation.h"
+#include "memory_resource.h"
+
+#include <cstddef>
 #include <exception>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 
 class BadAnyCast : public std::bad_cast {
     std::string message_;
@@ -17,50 +25,168 @@ public:
     }
 };
 
-class Base {
-public:
-    Base() = default;
-    virtual ~Base() = default;
-    virtual std::shared_ptr<Base> Clone() const = 0;
-};
+class Any {
+    const static size_t kInlineSize = 3 * sizeof(void*);
 
-template<typename T>
-class Derived : public Base {
-public:
-    T value;
+    union Storage {
+        alignas(void*) unsigned char buffer[kInlineSize];
+        void* heap;
+    };
 
-    Derived(const T& value) : value(value) {
+    // One static table per stored type replaces a virtual hierarchy: the
+    // object itself holds no vptr, and the table address doubles as a type id.
+    struct Operations {
+        void (*copy)(Storage& dst, const Storage& src);
+        void (*move)(Storage& dst, Storage& src) noexcept;
+        void (*destroy)(Storage& storage) noexcept;
+        const std::type_info& (*type)() noexcept;
+    };
+
+    // Values that fit into the buffer and cannot throw on move live inline;
+    // everything else goes to a heap block owned by this Any alone. The block
+    // remembers the resource it came from, so Any itself stays four words.
+    template <class T>
+    static constexpr bool FitsInline() {
+        return sizeof(T) <= kInlineSize && alignof(T) <= alignof(void*) &&
+               std::is_nothrow_move_constructible<T>::value;
     }
 
-    ~Derived() = default;
+    template <class T>
+    struct InlineHandler {
+        static T* Get(Storage& storage) {
+            return std::launder(reinterpret_cast<T*>(storage.buffer));
+        }
+
+        static const T* Get(const Storage& storage) {
+            return std::launder(reinterpret_cast<const T*>(storage.buffer));
+        }
+
+        template <class... Args>
+        static void Create(Storage& storage, MemoryResource*, Args&&... args) {
+            new (storage.buffer) T(std::forward<Args>(args)...);
+        }
+
+        static void Copy(Storage& dst, const Storage& src) {
+            Create(dst, nullptr, *Get(src));
+        }
+
+        static void Move(Storage& dst, Storage& src) noexcept {
+            Create(dst, nullptr, std::move(*Get(src)));
+            Get(src)->~T();
+        }
+
+        static void Destroy(Storage& storage) noexcept {
+            Get(storage)->~T();
+        }
+    };
+
+    template <class T>
+    struct HeapHandler {
+        struct Block {
+            T value;
+            MemoryResource* resource;
+
+            template <class... Args>
+            explicit Block(MemoryResource* resource, Args&&... args)
+                    : value(std::forward<Args>(args)...), resource(resource) {
+            }
+        };
 
-    std::shared_ptr<Base> Clone() const  override {
-        return std::make_shared<Derived<T>>(value);
+        static T* Get(Storage& storage) {
+            return &static_cast<Block*>(storage.heap)->value;
+        }
+
+        static const T* Get(const Storage& storage) {
+            return &static_cast<const Block*>(storage.heap)->value;
+        }
+
+        template <class... Args>
+        static void Create(Storage& storage, MemoryResource* resource, Args&&... args) {
+            storage.heap = NewObject<Block>(resource, resource, std::forward<Args>(args)...);
+            CONTAINERS_RECORD_ALLOCATION(kAny, sizeof(Block));
+        }
+
+        // Copies are not tied to the source's resource.
+        static void Copy(Storage& dst, const Storage& src) {
+            Create(dst, DefaultResource(), *Get(src));
+        }
+
+        static void Move(Storage& dst, Storage& src) noexcept {
+            dst.heap = src.heap;
+            src.heap = nullptr;
+        }
+
+        static void Destroy(Storage& storage) noexcept {
+            Block* block = static_cast<Block*>(storage.heap);
+            CONTAINERS_RECORD_DEALLOCATION(kAny, sizeof(Block));
+            DeleteObject(block->resource, block);
+        }
+    };
+
+    template <class T>
+    using Handler = typename std::conditional<FitsInline<T>(), InlineHandler<T>, HeapHandler<T>>::type;
+
+    template <class T>
+    static const std::type_info& TypeOf() noexcept {
+        return typeid(T);
     }
-};
 
-class Any {
-    std::shared_ptr<Base> base_ptr_;
+    template <class T>
+    static const Operations* OperationsFor() {
+        static const Operations operations = {
+                &Handler<T>::Copy,
+                &Handler<T>::Move,
+                &Handler<T>::Destroy,
+                &TypeOf<T>,
+        };
+        return &operations;
+    }
+
+    Storage storage_;
+    const Operations* operations_;
+
+    template <class T>
+    T* Get() {
+        if (operations_ != OperationsFor<T>()) {
+            return nullptr;
+        }
+        return Handler<T>::Get(storage_);
+    }
+
+    template <class T>
+    const T* Get() const {
+        if (operations_ != OperationsFor<T>()) {
+            return nullptr;
+        }
+        return Handler<T>::Get(storage_);
+    }
+
+    template <class T>
+    using EnableIfNotAny = typename std::enable_if<!std::is_same<typename std::decay<T>::type, Any>::value>::type;
 
 public:
 
-    Any() : base_ptr_(nullptr) {
+    Any() : operations_(nullptr) {
     }
 
-    Any(const Any& other) : base_ptr_(other.HasValue() ? other.base_ptr_->Clone() : nullptr) {
+    Any(const Any& other) : operations_(nullptr) {
+        if (other.HasValue()) {
+            other.operations_->copy(storage_, other.storage_);
+            operations_ = other.operations_;
+        }
     }
 
-    template<typename T>
-    Any(const T& value) : base_ptr_(std::make_shared<Derived<T>>(value)) {
+    template<typename T, typename = EnableIfNotAny<T>>
+    Any(T&& value) : operations_(nullptr) {
+        Emplace<typename std::decay<T>::type>(std::forward<T>(value));
     }
 
-    Any(Any&& other) noexcept {
-        if (!other.HasValue()) {
-            base_ptr_ = nullptr;
-            return;
+    Any(Any&& other) noexcept : operations_(nullptr) {
+        if (other.HasValue()) {
+            other.operations_->move(storage_, other.storage_);
+            operations_ = other.operations_;
+            other.operations_ = nullptr;
         }
-        base_ptr_ = other.base_ptr_->Clone();
-        other.base_ptr_ = nullptr;
     }
 
     ~Any() {
@@ -68,52 +194,120 @@ public:
     }
 
     void Reset() {
-        base_ptr_.reset();
+        if (HasValue()) {
+            operations_->destroy(storage_);
+            operations_ = nullptr;
+        }
     }
 
     bool HasValue() const {
-        return base_ptr_ != nullptr;
+        return operations_ != nullptr;
+    }
+
+    template<class T, class... Args>
+    T& Emplace(Args&&... args) {
+        return EmplaceIn<T>(DefaultResource(), std::forward<Args>(args)...);
+    }
+
+    // Like Emplace, with a value too big for the inline buffer placed in
+    // resource instead of DefaultResource().
+    template<class T, class... Args>
+    T& EmplaceIn(MemoryResource* resource, Args&&... args) {
+        Reset();
+        Handler<T>::Create(storage_, resource, std::forward<Args>(args)...);
+        operations_ = OperationsFor<T>();
+        return *Handler<T>::Get(storage_);
+    }
+
+    const std::type_info& Type() const {
+        return HasValue() ? operations_->type() : typeid(void);
     }
 
     Any& operator=(const Any& other) {
         if (this != &other) {
-            Reset();
-            base_ptr_ = other.base_ptr_->Clone();
+            Any tmp(other);
+            Swap(tmp);
         }
         return *this;
     }
 
-    template<typename U>
-    Any& operator=(const U& rhs) {
-        Reset();
-        base_ptr_ = std::make_shared<Derived<U>>(rhs);
+    template<typename U, typename = EnableIfNotAny<U>>
+    Any& operator=(U&& rhs) {
+        Any tmp(std::forward<U>(rhs));
+        Swap(tmp);
         return *this;
     }
 
     Any& operator=(Any&& rhs) noexcept {
         if (this != &rhs) {
             Reset();
-            base_ptr_ = rhs.base_ptr_;
-            rhs.base_ptr_ = nullptr;
+            if (rhs.HasValue()) {
+                rhs.operations_->move(storage_, rhs.storage_);
+                operations_ = rhs.operations_;
+                rhs.operations_ = nullptr;
+            }
         }
         return *this;
     }
 
     void Swap(Any& other) {
-        std::swap(this->base_ptr_, other.base_ptr_);
+        Any tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
     }
 
     template<class T>
-    friend T any_cast(const Any& a);
+    friend T* any_cast(Any* a) noexcept;
+
+    template<class T>
+    friend const T* any_cast(const Any* a) noexcept;
 };
 
+// Pointer forms: nullptr on a type mismatch instead of an exception.
 template<class T>
-T any_cast(const Any&   a) {
-    if (std::dynamic_pointer_cast<Derived<T>>(a.base_ptr_)) {
-        return std::dynamic_pointer_cast<Derived<T>>(a.base_ptr_)->value;
+T* any_cast(Any* a) noexcept {
+    return a != nullptr ? a->Get<T>() : nullptr;
+}
+
+template<class T>
+const T* any_cast(const Any* a) noexcept {
+    return a != nullptr ? a->Get<T>() : nullptr;
+}
+
+// T may be a value type, T& or const T&; references avoid the copy.
+template<class T>
+T any_cast(const Any& a) {
+    using Value = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+    static_assert(!std::is_lvalue_reference<T>::value || std::is_const<typename std::remove_reference<T>::type>::value,
+                  "any_cast of a const Any cannot return a non-const reference");
+
+    const Value* value = any_cast<Value>(&a);
+    if (value == nullptr) {
+        throw BadAnyCast{};
     }
-    throw BadAnyCast{};
+    return *value;
 }
 
-#endif // ANY_H
+template<class T>
+T any_cast(Any& a) {
+    using Value = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
 
+    Value* value = any_cast<Value>(&a);
+    if (value == nullptr) {
+        throw BadAnyCast{};
+    }
+    return *value;
+}
+
+template<class T>
+T any_cast(Any&& a) {
+    using Value = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+    Value* value = any_cast<Value>(&a);
+    if (value == nullptr) {
+        throw BadAnyCast{};
+    }
+    return static_cast<T>(std::move(*value));
+}
+
+#endif // ANY_H
@@ -0,0 +1,384 @@
+#ifndef ANY_VECTOR_H
+#define ANY_VECTOR_H
+
+#include "any.h"
+#include "vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+// Heterogeneous sequence that keeps values of the same type together: every
+// stored type gets its own contiguous column, and an 8-byte index entry per
+// element remembers (column, row) to preserve insertion order. ForEach<T>
+// streams one column linearly instead of chasing one heap pointer per value.
+class AnyVector {
+    struct ColumnOperations {
+        size_t size;
+        size_t alignment;
+        void (*relocate)(void* dst, void* src, size_t count);
+        void (*copy)(void* dst, const void* src, size_t count);
+        void (*destroy)(void* data, size_t count);
+        void (*to_any)(Any& dst, const void* value);
+        const std::type_info& (*type)() noexcept;
+    };
+
+    template <class T>
+    struct ColumnHandler {
+        // Sources are destroyed only once every value is in place, so a
+        // throwing copy leaves src as it was.
+        static void Relocate(void* dst, void* src, size_t count) {
+            T* from = static_cast<T*>(src);
+            T* to = static_cast<T*>(dst);
+            size_t i = 0;
+            try {
+                for (; i < count; ++i) {
+                    new (to + i) T(std::move_if_noexcept(from[i]));
+                }
+            } catch (...) {
+                Destroy(dst, i);
+                throw;
+            }
+            Destroy(src, count);
+        }
+
+        static void Copy(void* dst, const void* src, size_t count) {
+            const T* from = static_cast<const T*>(src);
+            T* to = static_cast<T*>(dst);
+            size_t i = 0;
+            try {
+                for (; i < count; ++i) {
+                    new (to + i) T(from[i]);
+                }
+            } catch (...) {
+                Destroy(dst, i);
+                throw;
+            }
+        }
+
+        static void Destroy(void* data, size_t count) {
+            T* values = static_cast<T*>(data);
+            for (size_t i = 0; i < count; ++i) {
+                values[i].~T();
+            }
+        }
+
+        static void ToAny(Any& dst, const void* value) {
+            dst = *static_cast<const T*>(value);
+        }
+
+        static const std::type_info& Type() noexcept {
+            return typeid(T);
+        }
+    };
+
+    template <class T>
+    static const ColumnOperations* OperationsFor() {
+        static const ColumnOperations operations = {
+                sizeof(T),
+                alignof(T),
+                &ColumnHandler<T>::Relocate,
+                &ColumnHandler<T>::Copy,
+                &ColumnHandler<T>::Destroy,
+                &ColumnHandler<T>::ToAny,
+                &ColumnHandler<T>::Type,
+        };
+        return &operations;
+    }
+
+    struct Column {
+        const ColumnOperations* operations;
+        unsigned char* data;
+        size_t size;
+        size_t capacity;
+
+        void* At(size_t row) {
+            return data + row * operations->size;
+        }
+
+        const void* At(size_t row) const {
+            return data + row * operations->size;
+        }
+    };
+
+    struct Entry {
+        uint32_t column;
+        uint32_t row;
+    };
+
+    const static size_t kIncreaseFactor = 2;
+
+    Vector<Column> columns_;
+    Vector<Entry> index_;
+
+    static unsigned char* Allocate(const ColumnOperations* operations, size_t count) {
+        return static_cast<unsigned char*>(
+                ::operator new(count * operations->size, std::align_val_t(operations->alignment)));
+    }
+
+    static void Deallocate(const ColumnOperations* operations, unsigned char* data) {
+        ::operator delete(data, std::align_val_t(operations->alignment));
+    }
+
+    template <class T>
+    size_t FindColumn() const {
+        const ColumnOperations* operations = OperationsFor<T>();
+        for (size_t i = 0; i < columns_.Size(); ++i) {
+            if (columns_[i].operations == operations) {
+                return i;
+            }
+        }
+        return columns_.Size();
+    }
+
+    template <class T>
+    Column& ColumnFor() {
+        size_t idx = FindColumn<T>();
+        if (idx == columns_.Size()) {
+            columns_.PushBack(Column{OperationsFor<T>(), nullptr, 0, 0});
+        }
+        return columns_[idx];
+    }
+
+    static void Grow(Column& column) {
+        size_t new_capacity = column.capacity == 0 ? 1 : column.capacity * kIncreaseFactor;
+        unsigned char* new_data = Allocate(column.operations, new_capacity);
+        try {
+            column.operations->relocate(new_data, column.data, column.size);
+        } catch (...) {
+            Deallocate(column.operations, new_data);
+            throw;
+        }
+        if (column.data != nullptr) {
+            Deallocate(column.operations, column.data);
+        }
+        column.data = new_data;
+        column.capacity = new_capacity;
+    }
+
+    void Release() {
+        for (size_t i = 0; i < columns_.Size(); ++i) {
+            Column& column = columns_[i];
+            column.operations->destroy(column.data, column.size);
+            if (column.data != nullptr) {
+                Deallocate(column.operations, column.data);
+            }
+        }
+        columns_.Clear();
+        index_.Clear();
+    }
+
+    // Any-like view of one element; valid until the AnyVector is modified.
+    // Value is void for AnyRef and const void for ConstAnyRef, which hands
+    // out only const access.
+    template <class Value>
+    class BasicAnyRef {
+        template <class T>
+        using Qualified = typename std::conditional<std::is_const<Value>::value, const T, T>::type;
+
+        const ColumnOperations* operations_;
+        Value* value_;
+
+    public:
+        BasicAnyRef(const ColumnOperations* operations, Value* value) : operations_(operations), value_(value) {
+        }
+
+        // AnyRef converts to ConstAnyRef, not the other way.
+        template <class Other, class = typename std::enable_if<std::is_convertible<Other*, Value*>::value>::type>
+        BasicAnyRef(const BasicAnyRef<Other>& other) : operations_(other.operations_), value_(other.value_) {
+        }
+
+        const std::type_info& Type() const {
+            return operations_->type();
+        }
+
+        template <class T>
+        bool Is() const {
+            return operations_ == OperationsFor<T>();
+        }
+
+        // nullptr on a type mismatch.
+        template <class T>
+        Qualified<T>* TryGet() const {
+            return Is<T>() ? static_cast<Qualified<T>*>(value_) : nullptr;
+        }
+
+        template <class T>
+        Qualified<T>& Get() const {
+            if (!Is<T>()) {
+                throw BadAnyCast{};
+            }
+            return *static_cast<Qualified<T>*>(value_);
+        }
+
+        Any ToAny() const {
+            Any res;
+            operations_->to_any(res, value_);
+            return res;
+        }
+
+        template <class Other>
+        friend class BasicAnyRef;
+    };
+
+public:
+    using AnyRef = BasicAnyRef<void>;
+    using ConstAnyRef = BasicAnyRef<const void>;
+
+    AnyVector() = default;
+
+    // Each column is in columns_ before it gets a buffer, so Release() can
+    // undo everything if a copy throws.
+    AnyVector(const AnyVector& other) : index_(other.index_) {
+        try {
+            for (size_t i = 0; i < other.columns_.Size(); ++i) {
+                const Column& from = other.columns_[i];
+                columns_.PushBack(Column{from.operations, nullptr, 0, 0});
+                if (from.size != 0) {
+                    Column& column = columns_.Back();
+                    column.data = Allocate(from.operations, from.size);
+                    column.capacity = from.size;
+                    from.operations->copy(column.data, from.data, from.size);
+                    column.size = from.size;
+                }
+            }
+        } catch (...) {
+            Release();
+            throw;
+        }
+    }
+
+    AnyVector(AnyVector&& other) noexcept {
+        Swap(other);
+    }
+
+    AnyVector& operator=(const AnyVector& other) {
+        if (this != &other) {
+            AnyVector tmp(other);
+            Swap(tmp);
+        }
+        return *this;
+    }
+
+    AnyVector& operator=(AnyVector&& other) noexcept {
+        if (this != &other) {
+            AnyVector tmp(std::move(other));
+            Swap(tmp);
+        }
+        return *this;
+    }
+
+    ~AnyVector() {
+        Release();
+    }
+
+    void Swap(AnyVector& other) {
+        columns_.Swap(other.columns_);
+        index_.Swap(other.index_);
+    }
+
+    size_t Size() const {
+        return index_.Size();
+    }
+
+    bool Empty() const {
+        return Size() == 0;
+    }
+
+    // Number of stored values of type T.
+    template <class T>
+    size_t Count() const {
+        size_t idx = FindColumn<T>();
+        return idx == columns_.Size() ? 0 : columns_[idx].size;
+    }
+
+    template <class T, class... Args>
+    T& EmplaceBack(Args&&... args) {
+        Column& column = ColumnFor<T>();
+        if (column.size == column.capacity) {
+            Grow(column);
+        }
+
+        T* value = new (column.At(column.size)) T(std::forward<Args>(args)...);
+        try {
+            index_.PushBack(Entry{static_cast<uint32_t>(&column - &columns_[0]), static_cast<uint32_t>(column.size)});
+        } catch (...) {
+            value->~T();
+            throw;
+        }
+        ++column.size;
+        return *value;
+    }
+
+    template <class T>
+    void PushBack(T&& value) {
+        EmplaceBack<typename std::decay<T>::type>(std::forward<T>(value));
+    }
+
+    // The last element is always the last row of its column.
+    void PopBack() {
+        if (Empty()) {
+            return;
+        }
+
+        Column& column = columns_[index_.Back().column];
+        --column.size;
+        column.operations->destroy(column.At(column.size), 1);
+        index_.PopBack();
+    }
+
+    void Clear() {
+        for (size_t i = 0; i < columns_.Size(); ++i) {
+            columns_[i].operations->destroy(columns_[i].data, columns_[i].size);
+            columns_[i].size = 0;
+        }
+        index_.Clear();
+    }
+
+    AnyRef operator[](size_t idx) {
+        const Entry& entry = index_[idx];
+        Column& column = columns_[entry.column];
+        return AnyRef(column.operations, column.At(entry.row));
+    }
+
+    ConstAnyRef operator[](size_t idx) const {
+        const Entry& entry = index_[idx];
+        const Column& column = columns_[entry.column];
+        return ConstAnyRef(column.operations, column.At(entry.row));
+    }
+
+    // Visits every value of type T in insertion order, straight through its
+    // contiguous column.
+    template <class T, class F>
+    void ForEach(F fn) {
+        size_t idx = FindColumn<T>();
+        if (idx == columns_.Size()) {
+            return;
+        }
+
+        T* values = reinterpret_cast<T*>(columns_[idx].data);
+        size_t count = columns_[idx].size;
+        for (size_t i = 0; i < count; ++i) {
+            fn(values[i]);
+        }
+    }
+
+    template <class T, class F>
+    void ForEach(F fn) const {
+        size_t idx = FindColumn<T>();
+        if (idx == columns_.Size()) {
+            return;
+        }
+
+        const T* values = reinterpret_cast<const T*>(columns_[idx].data);
+        size_t count = columns_[idx].size;
+        for (size_t i = 0; i < count; ++i) {
+            fn(values[i]);
+        }
+    }
+};
+
+#endif // ANY_VECTOR_H
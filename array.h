@@ -20,7 +20,7 @@ struct Array {
         return Size() == 0;
     }
 
-    T& operator[](int idx) {
+    T& operator[](size_t idx) {
         return buffer_[idx];
     }
 
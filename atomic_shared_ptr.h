@@ -0,0 +1,160 @@
+#ifndef ATOMIC_SHARED_PTR_H
+#define ATOMIC_SHARED_PTR_H
+
+#include "shared_and_weak_ptr.h"
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+// Atomic slot holding a SharedPtr, for read-mostly snapshots (configuration,
+// routing tables): many threads Load() the current version while a writer
+// occasionally Store()s a new one.
+//
+// Lock-free through a split reference count. The slot points to a Node that
+// owns one SharedPtr; the top 16 bits of the same word count readers that are
+// copying out of that node right now ("external" references). A reader bumps
+// the external count with one fetch_add, copies the SharedPtr and gives its
+// reference back. A writer that swaps a node out moves the external count it
+// saw into the node's internal count; whoever brings that to zero frees the
+// node. Assumes 64-bit user-space addresses that fit into 48 bits.
+template<class T>
+class AtomicSharedPtr {
+    static_assert(sizeof(uintptr_t) == 8, "AtomicSharedPtr packs a count into the upper pointer bits");
+
+    struct Node {
+        SharedPtr<T> value;
+        std::atomic<int64_t> internal;
+
+        explicit Node(SharedPtr<T> value) : value(std::move(value)), internal(0) {
+        }
+    };
+
+    const static int kCountShift = 48;
+    const static uintptr_t kOne = uintptr_t(1) << kCountShift;
+    const static uintptr_t kPointerMask = kOne - 1;
+
+    std::atomic<uintptr_t> packed_;
+
+    static Node* NodeOf(uintptr_t packed) {
+        return reinterpret_cast<Node*>(packed & kPointerMask);
+    }
+
+    static int64_t CountOf(uintptr_t packed) {
+        return static_cast<int64_t>(packed >> kCountShift);
+    }
+
+    static Node* MakeNode(SharedPtr<T> value) {
+        return value ? new Node(std::move(value)) : nullptr;
+    }
+
+    static void Retire(Node* node, int64_t delta) {
+        if (node != nullptr && node->internal.fetch_add(delta, std::memory_order_acq_rel) + delta == 0) {
+            delete node;
+        }
+    }
+
+    // Returns the word as it was, with our own external reference included.
+    uintptr_t AcquireReference() {
+        return packed_.fetch_add(kOne, std::memory_order_acquire) + kOne;
+    }
+
+    void ReleaseReference(Node* node) {
+        uintptr_t current = packed_.load(std::memory_order_relaxed);
+        while (NodeOf(current) == node) {
+            if (packed_.compare_exchange_weak(current, current - kOne, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+                return;
+            }
+        }
+
+        // Swapped out meanwhile: the writer has moved our reference into the
+        // node's internal count.
+        Retire(node, -1);
+    }
+
+    uintptr_t Swap(Node* node) {
+        return packed_.exchange(reinterpret_cast<uintptr_t>(node), std::memory_order_acq_rel);
+    }
+
+public:
+    AtomicSharedPtr() : packed_(0) {
+    }
+
+    explicit AtomicSharedPtr(SharedPtr<T> value) : packed_(reinterpret_cast<uintptr_t>(MakeNode(std::move(value)))) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ~AtomicSharedPtr() {
+        delete NodeOf(packed_.load(std::memory_order_acquire));
+    }
+
+    bool IsLockFree() const {
+        return packed_.is_lock_free();
+    }
+
+    SharedPtr<T> Load() {
+        Node* node = NodeOf(AcquireReference());
+        if (node == nullptr) {
+            // No node to free behind a null word, so a count left on it by a
+            // lost race is harmless: the next Store overwrites the whole word.
+            ReleaseReference(node);
+            return SharedPtr<T>();
+        }
+
+        SharedPtr<T> res = node->value;
+        ReleaseReference(node);
+        return res;
+    }
+
+    void Store(SharedPtr<T> desired) {
+        Exchange(std::move(desired));
+    }
+
+    SharedPtr<T> Exchange(SharedPtr<T> desired) {
+        uintptr_t old = Swap(MakeNode(std::move(desired)));
+        Node* node = NodeOf(old);
+        if (node == nullptr) {
+            return SharedPtr<T>();
+        }
+
+        // Readers may still be copying node->value, so copy rather than move.
+        SharedPtr<T> res = node->value;
+        Retire(node, CountOf(old));
+        return res;
+    }
+
+    // Replaces the value with desired if it currently holds the same pointer
+    // as expected; otherwise loads the current value into expected.
+    bool CompareExchange(SharedPtr<T>& expected, SharedPtr<T> desired) {
+        Node* new_node = MakeNode(std::move(desired));
+
+        while (true) {
+            uintptr_t current = AcquireReference();
+            Node* node = NodeOf(current);
+            T* current_ptr = node != nullptr ? node->value.Get() : nullptr;
+
+            if (current_ptr != expected.Get()) {
+                expected = node != nullptr ? node->value : SharedPtr<T>();
+                ReleaseReference(node);
+                delete new_node;
+                return false;
+            }
+
+            while (NodeOf(current) == node) {
+                if (packed_.compare_exchange_weak(current, reinterpret_cast<uintptr_t>(new_node),
+                                                  std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                    // The transferred count includes our own reference, which we drop here.
+                    Retire(node, CountOf(current) - 1);
+                    return true;
+                }
+            }
+
+            Retire(node, -1);
+        }
+    }
+};
+
+#endif // ATOMIC_SHARED_PTR_H
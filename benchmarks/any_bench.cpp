@@ -0,0 +1,81 @@
+// Micro-benchmark of Any against std::any: any_cast on a hit, any_cast on a
+// miss (pointer form), move assignment and copy construction, for a small
+// inline value, a string and a large heap-allocated struct. Size is the
+// sizeof of the stored value.
+
+#include "../any.h"
+#include "bench_util.h"
+
+#include <any>
+#include <string>
+
+const size_t kIterations = 10000000;
+
+struct Big {
+    char data[128];
+};
+
+template <class Wrapper, class T>
+double CastHit(const T& value) {
+    Wrapper wrapper(value);
+    uint64_t begin = NowNs();
+    for (size_t i = 0; i < kIterations; ++i) {
+        DoNotOptimize(any_cast<const T&>(wrapper));
+    }
+    return static_cast<double>(NowNs() - begin) / kIterations;
+}
+
+template <class Wrapper, class T>
+double CastMiss(const T& value) {
+    Wrapper wrapper(value);
+    uint64_t begin = NowNs();
+    for (size_t i = 0; i < kIterations; ++i) {
+        DoNotOptimize(any_cast<float>(&wrapper));
+    }
+    return static_cast<double>(NowNs() - begin) / kIterations;
+}
+
+template <class Wrapper, class T>
+double Move(const T& value) {
+    Wrapper first(value);
+    Wrapper second;
+    uint64_t begin = NowNs();
+    for (size_t i = 0; i < kIterations / 2; ++i) {
+        second = std::move(first);
+        first = std::move(second);
+    }
+    DoNotOptimize(first);
+    return static_cast<double>(NowNs() - begin) / kIterations;
+}
+
+template <class Wrapper, class T>
+double Copy(const T& value) {
+    Wrapper source(value);
+    uint64_t begin = NowNs();
+    for (size_t i = 0; i < kIterations / 10; ++i) {
+        Wrapper copy(source);
+        DoNotOptimize(copy);
+    }
+    return static_cast<double>(NowNs() - begin) / (kIterations / 10);
+}
+
+template <class T>
+void Run(BenchReport& report, const std::string& type, const T& value) {
+    using std::any_cast;
+    report.Add("cast_hit/" + type, "Any", sizeof(T), CastHit<Any>(value));
+    report.Add("cast_hit/" + type, "std::any", sizeof(T), CastHit<std::any>(value));
+    report.Add("cast_miss/" + type, "Any", sizeof(T), CastMiss<Any>(value));
+    report.Add("cast_miss/" + type, "std::any", sizeof(T), CastMiss<std::any>(value));
+    report.Add("move/" + type, "Any", sizeof(T), Move<Any>(value));
+    report.Add("move/" + type, "std::any", sizeof(T), Move<std::any>(value));
+    report.Add("copy/" + type, "Any", sizeof(T), Copy<Any>(value));
+    report.Add("copy/" + type, "std::any", sizeof(T), Copy<std::any>(value));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("any", argc, argv);
+    Run(report, "int", 42);
+    Run(report, "string", std::string("a string long enough to skip SSO"));
+    Run(report, "big", Big{});
+    return report.Write();
+}
@@ -0,0 +1,85 @@
+// Array against std::array: Fill, sequential and random reads and copy
+// assignment. The size is a template argument, so the sweep is fixed at
+// compile time (8 to 1M elements) and cut at --max-size; the arrays live on
+// the heap to stay off the stack. Times are per element.
+
+#include "../array.h"
+#include "bench_util.h"
+
+#include <array>
+#include <memory>
+
+template <size_t N>
+void Fill(Array<int64_t, N>& array, int64_t value) {
+    array.Fill(value);
+}
+
+template <size_t N>
+void Fill(std::array<int64_t, N>& array, int64_t value) {
+    array.fill(value);
+}
+
+template <class A, size_t N>
+void Run(BenchReport& report, const char* impl) {
+    const size_t reps = Repetitions(N);
+    std::unique_ptr<A> array(new A());
+    std::unique_ptr<A> copy(new A());
+    for (size_t i = 0; i < N; ++i) {
+        (*array)[i] = static_cast<int64_t>(i);
+    }
+
+    report.Add("fill", impl, N, NsPerOp(N * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            Fill(*copy, static_cast<int64_t>(rep));
+            DoNotOptimize((*copy)[N - 1]);
+        }
+    }));
+
+    const A& view = *array;
+    report.Add("sequential_read", impl, N, NsPerOp(N * reps, [&] {
+        int64_t sum = 0;
+        for (size_t rep = 0; rep < reps; ++rep) {
+            for (size_t i = 0; i < N; ++i) {
+                sum += view[i];
+            }
+            DoNotOptimize(sum);
+        }
+    }));
+
+    report.Add("random_read", impl, N, NsPerOp(N * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < N * reps; ++i) {
+            sum += view[random.Below(N)];
+        }
+        DoNotOptimize(sum);
+    }));
+
+    report.Add("copy", impl, N, NsPerOp(N * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            *copy = view;
+            DoNotOptimize((*copy)[N - 1]);
+        }
+    }));
+}
+
+template <size_t N>
+void RunSize(BenchReport& report, size_t max_size) {
+    if (N <= max_size) {
+        Run<Array<int64_t, N>, N>(report, "Array");
+        Run<std::array<int64_t, N>, N>(report, "std::array");
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("array", argc, argv);
+    size_t max_size = report.Sizes().back();
+    RunSize<8>(report, max_size);
+    RunSize<64>(report, max_size);
+    RunSize<512>(report, max_size);
+    RunSize<4096>(report, max_size);
+    RunSize<32768>(report, max_size);
+    RunSize<262144>(report, max_size);
+    RunSize<1048576>(report, max_size);
+    return report.Write();
+}
@@ -0,0 +1,86 @@
+// Reader throughput of AtomicSharedPtr::Load against copying a SharedPtr
+// under a mutex, with one writer publishing a new table every millisecond.
+
+#include "../atomic_shared_ptr.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+const uint64_t kRunNs = 200 * 1000 * 1000;
+
+struct Table {
+    int64_t version;
+    int64_t entries[7];
+
+    explicit Table(int64_t version) : version(version), entries() {
+    }
+};
+
+class LockedSlot {
+    SharedPtr<Table> value_;
+    std::mutex mutex_;
+
+public:
+    explicit LockedSlot(SharedPtr<Table> value) : value_(std::move(value)) {
+    }
+
+    SharedPtr<Table> Load() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return value_;
+    }
+
+    void Store(SharedPtr<Table> value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        value_.Swap(value);
+    }
+};
+
+template <class Slot>
+double Run(size_t readers) {
+    Slot slot(MakeShared<Table>(0));
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> total(0);
+    std::vector<std::thread> threads;
+
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back([&] {
+            uint64_t loads = 0;
+            int64_t sum = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                SharedPtr<Table> table = slot.Load();
+                sum += table->version;
+                ++loads;
+            }
+            DoNotOptimize(sum);
+            total.fetch_add(loads);
+        });
+    }
+
+    threads.emplace_back([&] {
+        for (int64_t version = 1; !stop.load(std::memory_order_relaxed); ++version) {
+            slot.Store(MakeShared<Table>(version));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    uint64_t begin = NowNs();
+    std::this_thread::sleep_for(std::chrono::nanoseconds(kRunNs));
+    stop.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(total.load()) * 1e3 / (NowNs() - begin);
+}
+
+// Size is the number of reader threads.
+int main(int argc, char** argv) {
+    BenchReport report("atomic_shared_ptr", argc, argv);
+    for (size_t readers = 1; readers <= 64; readers *= 2) {
+        report.AddRate("load", "AtomicSharedPtr", readers, Run<AtomicSharedPtr<Table>>(readers), "Mloads/s");
+        report.AddRate("load", "mutex", readers, Run<LockedSlot>(readers), "Mloads/s");
+    }
+    return report.Write();
+}
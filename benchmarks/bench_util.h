@@ -0,0 +1,175 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Largest container size of the size sweeps; CMake sets it from
+// CONTAINERS_BENCH_MAX_SIZE, --max-size=N overrides it per run.
+#ifndef BENCH_MAX_SIZE
+#define BENCH_MAX_SIZE 1048576
+#endif
+
+inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sorts the samples in place.
+inline uint64_t Percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    size_t idx = static_cast<size_t>(fraction * (samples.size() - 1));
+    return samples[idx];
+}
+
+// Keeps the optimizer from discarding a computed value.
+template <class T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs body once and returns its time divided by ops.
+template <class Body>
+double NsPerOp(size_t ops, Body body) {
+    uint64_t begin = NowNs();
+    body();
+    return static_cast<double>(NowNs() - begin) / (ops > 0 ? ops : 1);
+}
+
+// Cheap deterministic index generator (LCG), so that random access does not
+// measure the random number generator or a precomputed index array.
+class FastRandom {
+    uint64_t state_;
+
+public:
+    explicit FastRandom(uint64_t seed = 42) : state_(seed) {
+    }
+
+    // Uniform in [0, bound), bound < 2^32.
+    size_t Below(size_t bound) {
+        state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<size_t>(((state_ >> 32) * bound) >> 32);
+    }
+};
+
+// How often to repeat a pass over size elements so that every measurement
+// touches about the same number of elements (at least one pass).
+inline size_t Repetitions(size_t size) {
+    const size_t budget = 1 << 22;
+    return size < budget ? budget / size : 1;
+}
+
+// Collects the results of one benchmark program and writes them as a single
+// JSON document, to stdout or to the file given with --out=FILE:
+//
+//   {"benchmark": "vector", "results": [
+//     {"name": "push_back", "impl": "Vector", "size": 512, "value": 1.9,
+//      "unit": "ns/op", "better": "lower"}, ...]}
+//
+// size is the element count unless the benchmark says otherwise (threads,
+// bytes). benchmarks/compare.py matches results by (benchmark, name, impl,
+// size).
+class BenchReport {
+    struct Result {
+        std::string name;
+        std::string impl;
+        size_t size;
+        double value;
+        std::string unit;
+        bool higher_is_better;
+    };
+
+    std::string benchmark_;
+    std::string out_;
+    size_t max_size_ = BENCH_MAX_SIZE;
+    std::vector<Result> results_;
+
+    static void WriteString(FILE* file, const std::string& str) {
+        std::fputc('"', file);
+        for (char symbol : str) {
+            if (symbol == '"' || symbol == '\\') {
+                std::fputc('\\', file);
+            }
+            std::fputc(symbol, file);
+        }
+        std::fputc('"', file);
+    }
+
+public:
+    BenchReport(const char* benchmark, int argc, char** argv) : benchmark_(benchmark) {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strncmp(argv[i], "--max-size=", 11) == 0) {
+                max_size_ = std::strtoull(argv[i] + 11, nullptr, 10);
+            } else if (std::strncmp(argv[i], "--out=", 6) == 0) {
+                out_ = argv[i] + 6;
+            } else {
+                std::fprintf(stderr, "usage: %s [--max-size=N] [--out=FILE]\n", argv[0]);
+                std::exit(2);
+            }
+        }
+    }
+
+    // first, 8 * first, 64 * first, ... below the maximum, then the maximum
+    // itself.
+    std::vector<size_t> Sizes(size_t first = 8) const {
+        std::vector<size_t> sizes;
+        for (size_t size = first; size < max_size_; size *= 8) {
+            sizes.push_back(size);
+        }
+        sizes.push_back(max_size_);
+        return sizes;
+    }
+
+    // Times and other costs: lower is better.
+    void Add(const std::string& name, const std::string& impl, size_t size, double value,
+             const std::string& unit = "ns/op") {
+        results_.push_back(Result{name, impl, size, value, unit, false});
+    }
+
+    // Throughputs: higher is better.
+    void AddRate(const std::string& name, const std::string& impl, size_t size, double value,
+                 const std::string& unit) {
+        results_.push_back(Result{name, impl, size, value, unit, true});
+    }
+
+    // Returns the exit code for main().
+    int Write() const {
+        FILE* file = out_.empty() ? stdout : std::fopen(out_.c_str(), "w");
+        if (file == nullptr) {
+            std::perror(out_.c_str());
+            return 1;
+        }
+
+        std::fprintf(file, "{\"benchmark\": ");
+        WriteString(file, benchmark_);
+        std::fprintf(file, ", \"results\": [");
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const Result& result = results_[i];
+            std::fprintf(file, "%s\n  {\"name\": ", i == 0 ? "" : ",");
+            WriteString(file, result.name);
+            std::fprintf(file, ", \"impl\": ");
+            WriteString(file, result.impl);
+            std::fprintf(file, ", \"size\": %zu, \"value\": %.4f, \"unit\": ", result.size, result.value);
+            WriteString(file, result.unit);
+            std::fprintf(file, ", \"better\": \"%s\"}", result.higher_is_better ? "higher" : "lower");
+        }
+        std::fprintf(file, "\n]}\n");
+
+        if (file != stdout) {
+            std::fclose(file);
+        }
+        return 0;
+    }
+};
+
+#endif // BENCH_UTIL_H
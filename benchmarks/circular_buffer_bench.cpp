@@ -0,0 +1,106 @@
+// CircularBuffer against std::deque (the closest std:: ring-like container)
+// across sizes: growth at either end, FIFO churn at a steady size with and
+// without a Reserve() up front, and random reads. Times are per element.
+
+#include "../deque.h"
+#include "bench_util.h"
+
+#include <deque>
+
+using Custom = CircularBuffer<int64_t>;
+using Standard = std::deque<int64_t>;
+
+void PushBack(Custom& buffer, int64_t value) {
+    buffer.PushBack(value);
+}
+
+void PushBack(Standard& buffer, int64_t value) {
+    buffer.push_back(value);
+}
+
+void PushFront(Custom& buffer, int64_t value) {
+    buffer.PushFront(value);
+}
+
+void PushFront(Standard& buffer, int64_t value) {
+    buffer.push_front(value);
+}
+
+void PopFront(Custom& buffer) {
+    buffer.PopFront();
+}
+
+void PopFront(Standard& buffer) {
+    buffer.pop_front();
+}
+
+template <class B>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    const size_t reps = Repetitions(size);
+
+    report.Add("push_back", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            B buffer;
+            for (size_t i = 0; i < size; ++i) {
+                PushBack(buffer, static_cast<int64_t>(i));
+            }
+            DoNotOptimize(buffer[size - 1]);
+        }
+    }));
+
+    report.Add("push_front", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            B buffer;
+            for (size_t i = 0; i < size; ++i) {
+                PushFront(buffer, static_cast<int64_t>(i));
+            }
+            DoNotOptimize(buffer[0]);
+        }
+    }));
+
+    B buffer;
+    for (size_t i = 0; i < size; ++i) {
+        PushBack(buffer, static_cast<int64_t>(i));
+    }
+
+    report.Add("fifo", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t i = 0; i < size * reps; ++i) {
+            PushBack(buffer, static_cast<int64_t>(i));
+            PopFront(buffer);
+        }
+        DoNotOptimize(buffer[0]);
+    }));
+
+    const B& view = buffer;
+    report.Add("random_read", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            sum += view[random.Below(size)];
+        }
+        DoNotOptimize(sum);
+    }));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("circular_buffer", argc, argv);
+    for (size_t size : report.Sizes()) {
+        Run<Custom>(report, "CircularBuffer", size);
+        Run<Standard>(report, "std::deque", size);
+
+        const size_t reps = Repetitions(size);
+        Custom buffer;
+        buffer.Reserve(size + 1);
+        for (size_t i = 0; i < size; ++i) {
+            buffer.PushBack(static_cast<int64_t>(i));
+        }
+        report.Add("fifo_reserved", "CircularBuffer", size, NsPerOp(size * reps, [&] {
+            for (size_t i = 0; i < size * reps; ++i) {
+                buffer.PushBack(static_cast<int64_t>(i));
+                buffer.PopFront();
+            }
+            DoNotOptimize(buffer[0]);
+        }));
+    }
+    return report.Write();
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Compares benchmark results against a saved baseline.
+
+Both arguments are either JSON files written by the benchmarks (--out=FILE)
+or directories of them (the bench_json target writes one per benchmark into
+<build>/bench_results). Results are matched by (benchmark, name, impl, size);
+a result is a regression when it is worse than the baseline by more than the
+threshold, in the direction given by its "better" field. The printed
+percentage is that change, positive meaning worse.
+
+    python3 benchmarks/compare.py baseline/ _build/bench_results/ --threshold 0.1
+
+Exits with 1 if anything regressed, so it can gate CI.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+
+def load(path):
+    files = [path]
+    if os.path.isdir(path):
+        files = sorted(os.path.join(path, name) for name in os.listdir(path) if name.endswith(".json"))
+
+    results = {}
+    for file_name in files:
+        with open(file_name) as file:
+            document = json.load(file)
+        for result in document["results"]:
+            key = (document["benchmark"], result["name"], result["impl"], result["size"])
+            results[key] = result
+    return results
+
+
+def change(baseline, current):
+    """Relative change, positive when current is worse."""
+    if baseline["value"] == 0:
+        return 0.0
+    delta = (current["value"] - baseline["value"]) / baseline["value"]
+    return -delta if current.get("better") == "higher" else delta
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown that counts as a regression (default 0.10)")
+    parser.add_argument("--all", action="store_true", help="print every matched result, not only regressions")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    improvements = 0
+    for key in sorted(set(baseline) & set(current), key=str):
+        worse = change(baseline[key], current[key])
+        if worse > args.threshold:
+            regressions += 1
+            status = "REGRESSION"
+        elif worse < -args.threshold:
+            improvements += 1
+            status = "improved"
+        elif args.all:
+            status = "ok"
+        else:
+            continue
+
+        benchmark, name, impl, size = key
+        print("%-10s %s/%s [%s] size=%d: %.4g -> %.4g %s (%+.1f%%)" % (
+            status, benchmark, name, impl, size, baseline[key]["value"], current[key]["value"],
+            current[key]["unit"], 100 * worse))
+
+    missing = len(set(baseline) - set(current))
+    added = len(set(current) - set(baseline))
+    print("%d regressions, %d improvements beyond %.0f%%; %d results only in the baseline, %d only in the "
+          "current run" % (regressions, improvements, 100 * args.threshold, missing, added))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,128 @@
+// Deque against std::deque across sizes: growth at either end, FIFO churn
+// (push_back + pop_front at a steady size), sequential and random reads,
+// copy construction and a move there and back. Times are per element unless
+// the unit says otherwise.
+
+#include "../deque.h"
+#include "bench_util.h"
+
+#include <deque>
+#include <utility>
+
+using Custom = Deque<int64_t>;
+using Standard = std::deque<int64_t>;
+
+void PushBack(Custom& deque, int64_t value) {
+    deque.PushBack(value);
+}
+
+void PushBack(Standard& deque, int64_t value) {
+    deque.push_back(value);
+}
+
+void PushFront(Custom& deque, int64_t value) {
+    deque.PushFront(value);
+}
+
+void PushFront(Standard& deque, int64_t value) {
+    deque.push_front(value);
+}
+
+void PopFront(Custom& deque) {
+    deque.PopFront();
+}
+
+void PopFront(Standard& deque) {
+    deque.pop_front();
+}
+
+size_t Size(const Custom& deque) {
+    return deque.Size();
+}
+
+size_t Size(const Standard& deque) {
+    return deque.size();
+}
+
+template <class D>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    const size_t reps = Repetitions(size);
+
+    report.Add("push_back", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            D deque;
+            for (size_t i = 0; i < size; ++i) {
+                PushBack(deque, static_cast<int64_t>(i));
+            }
+            DoNotOptimize(deque[size - 1]);
+        }
+    }));
+
+    report.Add("push_front", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            D deque;
+            for (size_t i = 0; i < size; ++i) {
+                PushFront(deque, static_cast<int64_t>(i));
+            }
+            DoNotOptimize(deque[0]);
+        }
+    }));
+
+    D deque;
+    for (size_t i = 0; i < size; ++i) {
+        PushBack(deque, static_cast<int64_t>(i));
+    }
+
+    report.Add("fifo", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t i = 0; i < size * reps; ++i) {
+            PushBack(deque, static_cast<int64_t>(i));
+            PopFront(deque);
+        }
+        DoNotOptimize(deque[0]);
+    }));
+
+    const D& view = deque;
+
+    report.Add("sequential_read", impl, size, NsPerOp(size * reps, [&] {
+        int64_t sum = 0;
+        for (size_t rep = 0; rep < reps; ++rep) {
+            for (size_t i = 0; i < size; ++i) {
+                sum += view[i];
+            }
+            DoNotOptimize(sum);
+        }
+    }));
+
+    report.Add("random_read", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            sum += view[random.Below(size)];
+        }
+        DoNotOptimize(sum);
+    }));
+
+    report.Add("copy", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            D copy(view);
+            DoNotOptimize(copy[size - 1]);
+        }
+    }));
+
+    report.Add("move_round_trip", impl, size, NsPerOp(reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            D other(std::move(deque));
+            deque = std::move(other);
+            DoNotOptimize(Size(deque));
+        }
+    }), "ns/round_trip");
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("deque", argc, argv);
+    for (size_t size : report.Sizes()) {
+        Run<Custom>(report, "Deque", size);
+        Run<Standard>(report, "std::deque", size);
+    }
+    return report.Write();
+}
@@ -0,0 +1,72 @@
+// Sweeps element sizes and page byte budgets for Deque: push_back, random
+// indexed reads and pop_front, in ns per element.
+
+#include "../deque.h"
+#include "bench_util.h"
+
+#include <random>
+#include <string>
+
+const size_t kTotalBytes = 16 << 20;
+const size_t kRandomReads = 1 << 20;
+
+template <size_t S>
+struct Blob {
+    unsigned char data[S];
+};
+
+template <size_t S, size_t Budget>
+void Run(BenchReport& report) {
+    const size_t page_size = DequePageSize<Blob<S>, Budget>();
+    const size_t count = kTotalBytes / S;
+    Deque<Blob<S>, page_size> deque;
+    Blob<S> blob{};
+
+    uint64_t begin = NowNs();
+    for (size_t i = 0; i < count; ++i) {
+        blob.data[0] = static_cast<unsigned char>(i);
+        deque.PushBack(blob);
+    }
+    uint64_t push_ns = NowNs() - begin;
+
+    std::mt19937_64 rng(42);
+    size_t sum = 0;
+    begin = NowNs();
+    for (size_t i = 0; i < kRandomReads; ++i) {
+        sum += deque[rng() % count].data[0];
+    }
+    uint64_t read_ns = NowNs() - begin;
+    DoNotOptimize(sum);
+
+    begin = NowNs();
+    for (size_t i = 0; i < count; ++i) {
+        deque.PopFront();
+    }
+    uint64_t pop_ns = NowNs() - begin;
+
+    std::string impl = "elem=" + std::to_string(S) + ",budget=" + std::to_string(Budget) +
+                       ",page=" + std::to_string(page_size);
+    report.Add("push_back", impl, count, static_cast<double>(push_ns) / count);
+    report.Add("random_read", impl, count, static_cast<double>(read_ns) / kRandomReads);
+    report.Add("pop_front", impl, count, static_cast<double>(pop_ns) / count);
+}
+
+template <size_t S>
+void SweepBudgets(BenchReport& report) {
+    Run<S, 256>(report);
+    Run<S, 1024>(report);
+    Run<S, 4096>(report);
+    Run<S, 16384>(report);
+    Run<S, 65536>(report);
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("deque_page", argc, argv);
+    SweepBudgets<1>(report);
+    SweepBudgets<8>(report);
+    SweepBudgets<32>(report);
+    SweepBudgets<128>(report);
+    SweepBudgets<512>(report);
+    SweepBudgets<2048>(report);
+    return report.Write();
+}
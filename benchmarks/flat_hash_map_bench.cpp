@@ -0,0 +1,195 @@
+// FlatHashMap against std::unordered_map from 1K entries up: insert into an
+// empty map, filling one through operator[] (checked afterwards, as each
+// assignment may grow the map), find of present keys in random order, find of
+// absent keys, and erase of every key. Integer keys and short string keys
+// (String against std::string). Times are per operation.
+
+#include "../flat_hash_map.h"
+#include "bench_util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+uint64_t Scramble(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+struct CustomInt {
+    using Map = FlatHashMap<int64_t, int64_t>;
+    using Key = int64_t;
+
+    static void Insert(Map& map, const Key& key, int64_t value) {
+        map.Insert(key, value);
+    }
+
+    static void Assign(Map& map, const Key& key, int64_t value) {
+        map[key] = value;
+    }
+
+    static const int64_t* Find(const Map& map, const Key& key) {
+        return map.Find(key);
+    }
+
+    static void Erase(Map& map, const Key& key) {
+        map.Erase(key);
+    }
+};
+
+struct StandardInt {
+    using Map = std::unordered_map<int64_t, int64_t>;
+    using Key = int64_t;
+
+    static void Insert(Map& map, const Key& key, int64_t value) {
+        map.emplace(key, value);
+    }
+
+    static void Assign(Map& map, const Key& key, int64_t value) {
+        map[key] = value;
+    }
+
+    static const int64_t* Find(const Map& map, const Key& key) {
+        auto it = map.find(key);
+        return it == map.end() ? nullptr : &it->second;
+    }
+
+    static void Erase(Map& map, const Key& key) {
+        map.erase(key);
+    }
+};
+
+struct CustomString {
+    using Map = FlatHashMap<String, int64_t>;
+    using Key = String;
+
+    static void Insert(Map& map, const Key& key, int64_t value) {
+        map.Insert(key, value);
+    }
+
+    static void Assign(Map& map, const Key& key, int64_t value) {
+        map[key] = value;
+    }
+
+    static const int64_t* Find(const Map& map, const Key& key) {
+        return map.Find(key);
+    }
+
+    static void Erase(Map& map, const Key& key) {
+        map.Erase(key);
+    }
+};
+
+struct StandardString {
+    using Map = std::unordered_map<std::string, int64_t>;
+    using Key = std::string;
+
+    static void Insert(Map& map, const Key& key, int64_t value) {
+        map.emplace(key, value);
+    }
+
+    static void Assign(Map& map, const Key& key, int64_t value) {
+        map[key] = value;
+    }
+
+    static const int64_t* Find(const Map& map, const Key& key) {
+        auto it = map.find(key);
+        return it == map.end() ? nullptr : &it->second;
+    }
+
+    static void Erase(Map& map, const Key& key) {
+        map.erase(key);
+    }
+};
+
+template <class Key>
+Key MakeKey(uint64_t value);
+
+template <>
+int64_t MakeKey<int64_t>(uint64_t value) {
+    return static_cast<int64_t>(Scramble(value));
+}
+
+template <>
+std::string MakeKey<std::string>(uint64_t value) {
+    return "key:" + std::to_string(Scramble(value));
+}
+
+template <>
+String MakeKey<String>(uint64_t value) {
+    return String(MakeKey<std::string>(value).c_str());
+}
+
+template <class Impl>
+void Run(BenchReport& report, const std::string& type, const char* impl, size_t size) {
+    using Key = typename Impl::Key;
+    std::vector<Key> hits;
+    std::vector<Key> misses;
+    hits.reserve(size);
+    misses.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        hits.push_back(MakeKey<Key>(i));
+        misses.push_back(MakeKey<Key>(i + size));
+    }
+
+    typename Impl::Map map;
+    report.Add("insert/" + type, impl, size, NsPerOp(size, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            Impl::Insert(map, hits[i], static_cast<int64_t>(i));
+        }
+    }));
+
+    typename Impl::Map assigned;
+    report.Add("assign/" + type, impl, size, NsPerOp(size, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            Impl::Assign(assigned, hits[i], static_cast<int64_t>(i));
+        }
+    }));
+    for (size_t i = 0; i < size; ++i) {
+        const int64_t* value = Impl::Find(assigned, hits[i]);
+        if (value == nullptr || *value != static_cast<int64_t>(i)) {
+            std::fprintf(stderr, "%s: operator[] lost key %zu of %zu\n", impl, i, size);
+            std::abort();
+        }
+    }
+
+    const size_t lookups = size * (Repetitions(size) > 4 ? 4 : Repetitions(size));
+    report.Add("find_hit/" + type, impl, size, NsPerOp(lookups, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < lookups; ++i) {
+            sum += *Impl::Find(map, hits[random.Below(size)]);
+        }
+        DoNotOptimize(sum);
+    }));
+
+    report.Add("find_miss/" + type, impl, size, NsPerOp(lookups, [&] {
+        FastRandom random;
+        size_t found = 0;
+        for (size_t i = 0; i < lookups; ++i) {
+            found += Impl::Find(map, misses[random.Below(size)]) != nullptr;
+        }
+        DoNotOptimize(found);
+    }));
+
+    report.Add("erase/" + type, impl, size, NsPerOp(size, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            Impl::Erase(map, hits[i]);
+        }
+    }));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("flat_hash_map", argc, argv);
+    for (size_t size : report.Sizes(1024)) {
+        Run<CustomInt>(report, "int", "FlatHashMap", size);
+        Run<StandardInt>(report, "int", "std::unordered_map", size);
+        Run<CustomString>(report, "string", "FlatHashMap", size);
+        Run<StandardString>(report, "string", "std::unordered_map", size);
+    }
+    return report.Write();
+}
@@ -0,0 +1,163 @@
+// DaryHeap of arity 2, 4 and 8 and IndexedHeap against std::priority_queue,
+// from 1K elements up: pushes of random keys into an empty heap, popping
+// everything, a steady-state mix (pop the top and push a later key, as a
+// timer queue does), and bulk construction from a range. IndexedHeap also
+// reports DecreaseKey of random handles. Times are per operation.
+
+#include "../heap.h"
+#include "bench_util.h"
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+template <size_t D>
+struct Dary {
+    using Heap = DaryHeap<int64_t, D>;
+
+    static void Build(Heap& heap, const std::vector<int64_t>& values) {
+        heap.Heapify(values.begin(), values.end());
+    }
+
+    static void Push(Heap& heap, int64_t value) {
+        heap.Push(value);
+    }
+
+    static int64_t Top(const Heap& heap) {
+        return heap.Top();
+    }
+
+    static void Pop(Heap& heap) {
+        heap.Pop();
+    }
+};
+
+// Output iterator that drops the handles Heapify() reports.
+struct DiscardHandles {
+    DiscardHandles& operator*() {
+        return *this;
+    }
+
+    DiscardHandles& operator++(int) {
+        return *this;
+    }
+
+    DiscardHandles& operator=(uint32_t) {
+        return *this;
+    }
+};
+
+struct Indexed {
+    using Heap = IndexedHeap<int64_t, 4>;
+
+    static void Build(Heap& heap, const std::vector<int64_t>& values) {
+        heap.Heapify(values.begin(), values.end(), DiscardHandles());
+    }
+
+    static void Push(Heap& heap, int64_t value) {
+        heap.Push(value);
+    }
+
+    static int64_t Top(const Heap& heap) {
+        return heap.Top();
+    }
+
+    static void Pop(Heap& heap) {
+        heap.Pop();
+    }
+};
+
+struct Standard {
+    using Heap = std::priority_queue<int64_t>;
+
+    static void Build(Heap& heap, const std::vector<int64_t>& values) {
+        heap = Heap(std::less<int64_t>(), values);
+    }
+
+    static void Push(Heap& heap, int64_t value) {
+        heap.push(value);
+    }
+
+    static int64_t Top(const Heap& heap) {
+        return heap.top();
+    }
+
+    static void Pop(Heap& heap) {
+        heap.pop();
+    }
+};
+
+template <class Impl>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    std::vector<int64_t> values(size);
+    FastRandom fill(11);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = static_cast<int64_t>(fill.Below(1u << 30));
+    }
+
+    typename Impl::Heap heap;
+    report.Add("push", impl, size, NsPerOp(size, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            Impl::Push(heap, values[i]);
+        }
+    }));
+
+    // Keys only get smaller, so the popped top is pushed back a random
+    // distance behind the current front.
+    const size_t steps = size * (Repetitions(size) > 4 ? 4 : Repetitions(size));
+    report.Add("pop_push", impl, size, NsPerOp(steps, [&] {
+        FastRandom random;
+        for (size_t i = 0; i < steps; ++i) {
+            int64_t top = Impl::Top(heap);
+            Impl::Pop(heap);
+            Impl::Push(heap, top - static_cast<int64_t>(random.Below(1u << 20)));
+        }
+    }));
+
+    report.Add("pop", impl, size, NsPerOp(size, [&] {
+        int64_t sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += Impl::Top(heap);
+            Impl::Pop(heap);
+        }
+        DoNotOptimize(sum);
+    }));
+
+    typename Impl::Heap built;
+    report.Add("heapify", impl, size, NsPerOp(size, [&] {
+        Impl::Build(built, values);
+    }));
+    DoNotOptimize(Impl::Top(built));
+}
+
+void RunDecreaseKey(BenchReport& report, size_t size) {
+    IndexedHeap<int64_t, 4, std::greater<int64_t>> heap;
+    std::vector<IndexedHeap<int64_t>::Handle> handles;
+    FastRandom fill(11);
+    for (size_t i = 0; i < size; ++i) {
+        handles.push_back(heap.Push(static_cast<int64_t>(fill.Below(1u << 30))));
+    }
+
+    const size_t steps = size * (Repetitions(size) > 4 ? 4 : Repetitions(size));
+    report.Add("decrease_key", "IndexedHeap<4>", size, NsPerOp(steps, [&] {
+        FastRandom random;
+        for (size_t i = 0; i < steps; ++i) {
+            IndexedHeap<int64_t>::Handle handle = handles[random.Below(size)];
+            heap.DecreaseKey(handle, heap.Get(handle) - static_cast<int64_t>(random.Below(1u << 10)));
+        }
+    }));
+    DoNotOptimize(heap.Top());
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("heap", argc, argv);
+    for (size_t size : report.Sizes(1024)) {
+        Run<Dary<2>>(report, "DaryHeap<2>", size);
+        Run<Dary<4>>(report, "DaryHeap<4>", size);
+        Run<Dary<8>>(report, "DaryHeap<8>", size);
+        Run<Indexed>(report, "IndexedHeap<4>", size);
+        Run<Standard>(report, "std::priority_queue", size);
+        RunDecreaseKey(report, size);
+    }
+    return report.Write();
+}
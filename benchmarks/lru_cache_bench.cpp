@@ -0,0 +1,113 @@
+// Read-through LruCache under a Zipfian key distribution (s = 0.99 over 256K
+// keys, a cache of 1/8 of them) at 1 to 64 threads. Every thread runs
+// GetOrLoad() over its own part of one pre-drawn key stream. Reports
+// throughput, the p99 of GetOrLoad() latency and the hit rate, for a single
+// shard (one lock for the whole cache, as with a hand-made cache) and for 64
+// shards.
+
+#include "../lru_cache.h"
+#include "bench_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t kKeys = 1 << 18;
+const size_t kCapacity = kKeys / 8;
+const size_t kStreamSize = 1 << 22;
+const size_t kOpsPerThread = 200000;
+const size_t kSampleEvery = 16;
+const double kZipfExponent = 0.99;
+
+// Keys drawn with P(rank r) proportional to 1 / r^s, scattered over the key
+// space so that popular keys do not share a shard by construction.
+std::vector<uint32_t> ZipfStream() {
+    std::vector<double> cdf(kKeys);
+    double sum = 0;
+    for (size_t rank = 0; rank < kKeys; ++rank) {
+        sum += 1.0 / std::pow(static_cast<double>(rank + 1), kZipfExponent);
+        cdf[rank] = sum;
+    }
+
+    FastRandom random(3);
+    std::vector<uint32_t> stream(kStreamSize);
+    for (size_t i = 0; i < kStreamSize; ++i) {
+        double point = static_cast<double>(random.Below(1u << 30)) / (1u << 30) * sum;
+        size_t rank = static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), point) - cdf.begin());
+        stream[i] = static_cast<uint32_t>((rank * 0x9e3779b1u) % kKeys);
+    }
+    return stream;
+}
+
+void Run(BenchReport& report, const std::vector<uint32_t>& stream, size_t shards, size_t threads_count) {
+    LruCacheOptions options;
+    options.max_entries = kCapacity;
+    options.shards = shards;
+    LruCache<uint32_t, uint64_t> cache(options);
+
+    auto load = [](uint32_t key) {
+        return static_cast<uint64_t>(key) * 2;
+    };
+    for (size_t i = 0; i < kCapacity * 4; ++i) {
+        cache.GetOrLoad(stream[i], load);
+    }
+    cache.ResetStats();
+
+    std::atomic<bool> start(false);
+    std::vector<std::vector<uint64_t>> latencies(threads_count);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&, t] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            size_t pos = t * (kStreamSize / threads_count);
+            uint64_t sum = 0;
+            for (size_t i = 0; i < kOpsPerThread; ++i, ++pos) {
+                uint32_t key = stream[pos % kStreamSize];
+                if (i % kSampleEvery == 0) {
+                    uint64_t begin = NowNs();
+                    sum += *cache.GetOrLoad(key, load);
+                    latencies[t].push_back(NowNs() - begin);
+                } else {
+                    sum += *cache.GetOrLoad(key, load);
+                }
+            }
+            DoNotOptimize(sum);
+        });
+    }
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t elapsed = NowNs() - begin;
+
+    std::vector<uint64_t> all;
+    for (auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+
+    std::string impl = "LruCache/" + std::to_string(shards) + (shards == 1 ? " shard" : " shards");
+    LruCacheStats stats = cache.Stats();
+    double mops = static_cast<double>(threads_count * kOpsPerThread) * 1e3 / elapsed;
+    report.AddRate("throughput", impl, threads_count, mops, "Mops/s");
+    report.Add("p99_latency", impl, threads_count, static_cast<double>(Percentile(all, 0.99)), "ns");
+    report.AddRate("hit_rate", impl, threads_count,
+                   100.0 * static_cast<double>(stats.hits) / static_cast<double>(stats.hits + stats.misses), "%");
+}
+
+// Size is the number of threads.
+int main(int argc, char** argv) {
+    BenchReport report("lru_cache", argc, argv);
+    std::vector<uint32_t> stream = ZipfStream();
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        Run(report, stream, 1, threads);
+        Run(report, stream, 64, threads);
+    }
+    return report.Write();
+}
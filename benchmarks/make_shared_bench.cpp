@@ -0,0 +1,89 @@
+// Allocation count and throughput of MakeShared against SharedPtr(new T) and
+// std::make_shared: create/destroy churn, and copy + dereference of live
+// pointers (which touches both the count and the object).
+
+#include "../shared_and_weak_ptr.h"
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    void* ptr = std::malloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+const size_t kObjects = 1 << 20;
+const size_t kCopyRounds = 8;
+
+struct Payload {
+    int64_t value;
+    int64_t padding[3];
+
+    explicit Payload(int64_t value) : value(value), padding() {
+    }
+};
+
+template <class Ptr, class Make>
+void Run(BenchReport& report, const char* name, Make make) {
+    std::vector<Ptr> ptrs;
+    ptrs.reserve(kObjects);
+
+    size_t allocations_before = allocations;
+    uint64_t begin = NowNs();
+    for (size_t i = 0; i < kObjects; ++i) {
+        ptrs.push_back(make(static_cast<int64_t>(i)));
+    }
+    uint64_t create_ns = NowNs() - begin;
+    double allocations_per_object = static_cast<double>(allocations - allocations_before) / kObjects;
+
+    int64_t sum = 0;
+    begin = NowNs();
+    for (size_t round = 0; round < kCopyRounds; ++round) {
+        for (size_t i = 0; i < kObjects; ++i) {
+            Ptr copy = ptrs[(i * 7919) % kObjects];
+            sum += copy->value;
+        }
+    }
+    uint64_t copy_ns = NowNs() - begin;
+    DoNotOptimize(sum);
+
+    begin = NowNs();
+    ptrs.clear();
+    uint64_t destroy_ns = NowNs() - begin;
+
+    report.Add("allocations", name, kObjects, allocations_per_object, "allocs/object");
+    report.Add("create", name, kObjects, static_cast<double>(create_ns) / kObjects);
+    report.Add("copy_deref", name, kObjects, static_cast<double>(copy_ns) / (kObjects * kCopyRounds));
+    report.Add("destroy", name, kObjects, static_cast<double>(destroy_ns) / kObjects);
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("make_shared", argc, argv);
+    Run<SharedPtr<Payload>>(report, "SharedPtr(new T)", [](int64_t v) {
+        return SharedPtr<Payload>(new Payload(v));
+    });
+    Run<SharedPtr<Payload>>(report, "MakeShared", [](int64_t v) { return MakeShared<Payload>(v); });
+    Run<SharedPtr<Payload>>(report, "AllocateShared", [](int64_t v) {
+        return AllocateShared<Payload>(std::allocator<Payload>(), v);
+    });
+    Run<std::shared_ptr<Payload>>(report, "std::make_shared", [](int64_t v) {
+        return std::make_shared<Payload>(v);
+    });
+    return report.Write();
+}
@@ -0,0 +1,48 @@
+// Per-request allocation cost: each "request" builds a few small containers
+// (CircularBuffer, String, Deque) and throws them away. With MonotonicArena
+// over a reused buffer the containers only bump a pointer and the whole
+// request is released at once.
+
+#include "../deque.h"
+#include "../string.h"
+#include "bench_util.h"
+
+const size_t kRequests = 20000;
+const size_t kElements = 64;
+
+template <class Release>
+double Run(MemoryResource* resource, Release release) {
+    uint64_t begin = NowNs();
+    int64_t sum = 0;
+    for (size_t request = 0; request < kRequests; ++request) {
+        {
+            CircularBuffer<int64_t> values(resource);
+            String name(resource);
+            Deque<int64_t> queue(resource);
+            for (size_t i = 0; i < kElements; ++i) {
+                values.PushBack(static_cast<int64_t>(i));
+                name.PushBack(static_cast<char>('a' + i % 26));
+                queue.PushFront(static_cast<int64_t>(i));
+            }
+            sum += values.Back() + name.Size() + queue[0];
+        }
+        release();
+    }
+    DoNotOptimize(sum);
+    return static_cast<double>(NowNs() - begin) / kRequests;
+}
+
+alignas(std::max_align_t) unsigned char request_buffer[1 << 16];
+
+int main(int argc, char** argv) {
+    BenchReport report("memory_resource", argc, argv);
+    MonotonicArena arena(request_buffer, sizeof(request_buffer));
+    PoolResource pool;
+    ThreadCacheResource thread_cache;
+
+    report.Add("request", "new/delete", kElements, Run(NewDeleteResource(), [] {}), "ns/request");
+    report.Add("request", "MonotonicArena", kElements, Run(&arena, [&] { arena.Release(); }), "ns/request");
+    report.Add("request", "PoolResource", kElements, Run(&pool, [] {}), "ns/request");
+    report.Add("request", "ThreadCacheResource", kElements, Run(&thread_cache, [] {}), "ns/request");
+    return report.Write();
+}
@@ -0,0 +1,158 @@
+// Contention benchmark: P producers and P consumers hand timestamps through
+// the queue, from one of each (the uncontended baseline) up to 32 of each.
+// Reports throughput and the p99 of push-to-pop latency, next to a Deque
+// guarded by a single mutex (the setup the queue replaces). Every queue runs
+// twice: spinning on TryPush/TryPop with a yield between attempts, and with
+// the blocking Push/Pop, which park the thread on a condition variable.
+
+#include "../mpmc_queue.h"
+#include "../deque.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class LockedDeque {
+    Deque<uint64_t> deque_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+
+public:
+    explicit LockedDeque(size_t) {
+    }
+
+    bool TryPush(uint64_t value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deque_.PushBack(value);
+        return true;
+    }
+
+    bool TryPop(uint64_t& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (deque_.Size() == 0) {
+            return false;
+        }
+        value = deque_[0];
+        deque_.PopFront();
+        return true;
+    }
+
+    // Unbounded, so only Pop() ever waits. A run uses either these or the
+    // Try* calls, never both: TryPush() does not wake a waiting Pop().
+    void Push(uint64_t value) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            deque_.PushBack(value);
+        }
+        not_empty_.notify_one();
+    }
+
+    void Pop(uint64_t& value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (deque_.Size() == 0) {
+            not_empty_.wait(lock);
+        }
+        value = deque_[0];
+        deque_.PopFront();
+    }
+};
+
+const size_t kOpsPerProducer = 100000;
+const size_t kCapacity = 1024;
+const size_t kSampleEvery = 16;
+const size_t kMaxPairs = 32;
+
+enum Mode {
+    kSpin,
+    kBlocking,
+};
+
+template <class Queue>
+void Push(Queue& queue, Mode mode, uint64_t value) {
+    if (mode == kBlocking) {
+        queue.Push(value);
+        return;
+    }
+    while (!queue.TryPush(value)) {
+        std::this_thread::yield();
+    }
+}
+
+template <class Queue>
+void Pop(Queue& queue, Mode mode, uint64_t& value) {
+    if (mode == kBlocking) {
+        queue.Pop(value);
+        return;
+    }
+    while (!queue.TryPop(value)) {
+        std::this_thread::yield();
+    }
+}
+
+template <class Queue>
+void Run(BenchReport& report, const std::string& name, Mode mode, size_t pairs) {
+    Queue queue(kCapacity);
+    std::atomic<bool> start(false);
+    std::vector<std::vector<uint64_t>> latencies(pairs);
+    std::vector<std::thread> threads;
+
+    for (size_t p = 0; p < pairs; ++p) {
+        threads.emplace_back([&] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < kOpsPerProducer; ++i) {
+                Push(queue, mode, NowNs());
+            }
+        });
+    }
+
+    for (size_t c = 0; c < pairs; ++c) {
+        threads.emplace_back([&, c] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            uint64_t stamp = 0;
+            for (size_t i = 0; i < kOpsPerProducer; ++i) {
+                Pop(queue, mode, stamp);
+                if (i % kSampleEvery == 0) {
+                    latencies[c].push_back(NowNs() - stamp);
+                }
+            }
+        });
+    }
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t elapsed = NowNs() - begin;
+
+    std::vector<uint64_t> all;
+    for (auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+
+    std::string impl = mode == kBlocking ? name + "/blocking" : name + "/spin";
+    size_t threads_count = threads.size();
+    double mops = static_cast<double>(pairs * kOpsPerProducer) * 1e3 / elapsed;
+    report.AddRate("throughput", impl, threads_count, mops, "Mops/s");
+    report.Add("p99_latency", impl, threads_count, static_cast<double>(Percentile(all, 0.99)), "ns");
+}
+
+// Size is the total number of threads, producers plus consumers; size 2 is
+// the 1-producer/1-consumer baseline.
+int main(int argc, char** argv) {
+    BenchReport report("mpmc_queue", argc, argv);
+    for (size_t pairs = 1; pairs <= kMaxPairs; pairs *= 2) {
+        for (Mode mode : {kSpin, kBlocking}) {
+            Run<MPMCQueue<uint64_t>>(report, "mpmc", mode, pairs);
+            Run<LockedDeque>(report, "locked_deque", mode, pairs);
+        }
+    }
+    return report.Write();
+}
@@ -0,0 +1,122 @@
+// Acquire/release through ObjectPool against new/delete (MakeUnique) for a
+// request-context-like object with a heap buffer. "local" churns a window of
+// live objects on each thread; "cross" has producers acquire and consumers
+// drop, so every object is returned on a different thread.
+
+#include "../mpmc_queue.h"
+#include "../object_pool.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+const size_t kOpsPerThread = 1 << 19;
+const size_t kWindow = 64;
+const size_t kBufferSize = 512;
+
+struct RequestContext {
+    int64_t id = 0;
+    char* buffer;
+
+    RequestContext() : buffer(new char[kBufferSize]) {
+    }
+
+    RequestContext& operator=(RequestContext&& other) noexcept {
+        id = other.id;
+        return *this;
+    }
+
+    ~RequestContext() {
+        delete[] buffer;
+    }
+};
+
+template <class Ptr, class Make>
+double RunLocal(size_t threads_count, Make make) {
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&] {
+            std::vector<Ptr> window(kWindow);
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < kOpsPerThread; ++i) {
+                Ptr& slot = window[i % kWindow];
+                slot = make();
+                slot->id = static_cast<int64_t>(i);
+                slot->buffer[0] = 1;
+            }
+        });
+    }
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(NowNs() - begin) / (kOpsPerThread * threads_count);
+}
+
+template <class Ptr, class Make>
+double RunCross(size_t pairs, Make make) {
+    MPMCQueue<Ptr> queue(1024);
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+
+    for (size_t p = 0; p < pairs; ++p) {
+        threads.emplace_back([&] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < kOpsPerThread; ++i) {
+                Ptr ptr = make();
+                ptr->id = static_cast<int64_t>(i);
+                queue.Push(std::move(ptr));
+            }
+        });
+        threads.emplace_back([&] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            Ptr ptr;
+            for (size_t i = 0; i < kOpsPerThread; ++i) {
+                queue.Pop(ptr);
+                ptr.Reset();
+            }
+        });
+    }
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(NowNs() - begin) / (kOpsPerThread * pairs);
+}
+
+// Size is the number of threads.
+int main(int argc, char** argv) {
+    BenchReport report("object_pool", argc, argv);
+    ObjectPoolOptions options;
+    options.warm_up = 1024;
+
+    for (size_t threads = 1; threads <= 8; threads *= 2) {
+        ObjectPool<RequestContext> pool(options);
+        double pooled = RunLocal<PoolPtr<RequestContext>>(threads, [&] { return pool.Acquire(); });
+        double heap = RunLocal<UniquePtr<RequestContext>>(threads, [] { return MakeUnique<RequestContext>(); });
+        report.Add("local", "ObjectPool", threads, pooled);
+        report.Add("local", "new/delete", threads, heap);
+    }
+
+    for (size_t pairs = 1; pairs <= 4; pairs *= 2) {
+        ObjectPool<RequestContext> pool(options);
+        double pooled = RunCross<PoolPtr<RequestContext>>(pairs, [&] { return pool.Acquire(); });
+        double heap = RunCross<UniquePtr<RequestContext>>(pairs, [] { return MakeUnique<RequestContext>(); });
+        report.Add("cross", "ObjectPool", pairs * 2, pooled);
+        report.Add("cross", "new/delete", pairs * 2, heap);
+    }
+    return report.Write();
+}
@@ -0,0 +1,127 @@
+// FlatMap and BTreeMap against std::map with integer keys: building the map
+// from keys in random order (FlatMap through one InsertBatch, the others
+// key by key), find of present keys in random order, and scans of 64
+// consecutive entries from random starting keys. Find is per lookup, scan
+// per visited entry.
+
+#include "../btree_map.h"
+#include "../flat_map.h"
+#include "bench_util.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+const static size_t kScanLength = 64;
+
+struct CustomFlat {
+    using Map = FlatMap<int64_t, int64_t>;
+
+    static void Build(Map& map, const std::vector<std::pair<int64_t, int64_t>>& entries) {
+        map.InsertBatch(entries.begin(), entries.end());
+    }
+
+    static const int64_t* Find(const Map& map, int64_t key) {
+        return map.Find(key);
+    }
+
+    static int64_t Scan(Map& map, int64_t from, int64_t to) {
+        int64_t sum = 0;
+        map.ForEachInRange(from, to, [&sum](const int64_t&, int64_t& value) { sum += value; });
+        return sum;
+    }
+};
+
+struct CustomBTree {
+    using Map = BTreeMap<int64_t, int64_t>;
+
+    static void Build(Map& map, const std::vector<std::pair<int64_t, int64_t>>& entries) {
+        for (const auto& entry : entries) {
+            map.Insert(entry.first, entry.second);
+        }
+    }
+
+    static const int64_t* Find(const Map& map, int64_t key) {
+        return map.Find(key);
+    }
+
+    static int64_t Scan(Map& map, int64_t from, int64_t to) {
+        int64_t sum = 0;
+        map.ForEachInRange(from, to, [&sum](const int64_t&, int64_t& value) { sum += value; });
+        return sum;
+    }
+};
+
+struct Standard {
+    using Map = std::map<int64_t, int64_t>;
+
+    static void Build(Map& map, const std::vector<std::pair<int64_t, int64_t>>& entries) {
+        for (const auto& entry : entries) {
+            map.emplace(entry.first, entry.second);
+        }
+    }
+
+    static const int64_t* Find(const Map& map, int64_t key) {
+        auto it = map.find(key);
+        return it == map.end() ? nullptr : &it->second;
+    }
+
+    static int64_t Scan(Map& map, int64_t from, int64_t to) {
+        int64_t sum = 0;
+        for (auto it = map.lower_bound(from); it != map.end() && it->first < to; ++it) {
+            sum += it->second;
+        }
+        return sum;
+    }
+};
+
+// Keys are 0, 2, 4, ... so that a scan of [k, k + 2 * kScanLength) visits
+// kScanLength entries.
+template <class Impl>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    std::vector<std::pair<int64_t, int64_t>> entries;
+    entries.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        entries.emplace_back(static_cast<int64_t>(2 * i), static_cast<int64_t>(i));
+    }
+    FastRandom shuffle(7);
+    for (size_t i = size; i > 1; --i) {
+        std::swap(entries[i - 1], entries[shuffle.Below(i)]);
+    }
+
+    typename Impl::Map map;
+    report.Add("build", impl, size, NsPerOp(size, [&] {
+        Impl::Build(map, entries);
+    }));
+
+    const size_t lookups = size * (Repetitions(size) > 4 ? 4 : Repetitions(size));
+    report.Add("find", impl, size, NsPerOp(lookups, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < lookups; ++i) {
+            sum += *Impl::Find(map, static_cast<int64_t>(2 * random.Below(size)));
+        }
+        DoNotOptimize(sum);
+    }));
+
+    const size_t scans = lookups / kScanLength + 1;
+    report.Add("scan", impl, size, NsPerOp(scans * kScanLength, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < scans; ++i) {
+            int64_t from = static_cast<int64_t>(2 * random.Below(size));
+            sum += Impl::Scan(map, from, from + static_cast<int64_t>(2 * kScanLength));
+        }
+        DoNotOptimize(sum);
+    }));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("ordered_map", argc, argv);
+    for (size_t size : report.Sizes(1024)) {
+        Run<CustomFlat>(report, "FlatMap", size);
+        Run<CustomBTree>(report, "BTreeMap", size);
+        Run<Standard>(report, "std::map", size);
+    }
+    return report.Write();
+}
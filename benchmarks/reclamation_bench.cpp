@@ -0,0 +1,175 @@
+// Read throughput of a slot that one writer keeps replacing, with the old
+// value reclaimed through EpochReclaimer, HazardPointers or SharedPtr copies
+// (AtomicSharedPtr::Load). Doubles as a stress test: every node carries a
+// magic word that its destructor overwrites, and readers count the freed
+// nodes they observe, which must stay zero. Best run under ASan as well.
+
+#include "../atomic_shared_ptr.h"
+#include "../reclamation.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <thread>
+
+const uint64_t kRunNs = 200000000;
+const uint64_t kAlive = 0xA11CEA11CEA11CEull;
+const uint64_t kDead = 0xDEADDEADDEADDEADull;
+
+std::atomic<int64_t> live_nodes(0);
+
+struct Node {
+    uint64_t magic;
+    int64_t value;
+
+    explicit Node(int64_t value) : magic(kAlive), value(value) {
+        live_nodes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Node() {
+        magic = kDead;
+        live_nodes.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+struct Result {
+    double reads_per_us;
+    uint64_t bad_reads;
+};
+
+// Read(uint64_t& bad) returns the value seen; Write(int64_t) installs a new node.
+template <class Slot>
+Result Run(size_t readers_count) {
+    Slot slot;
+    std::atomic<bool> start(false);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> bad_reads(0);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < readers_count; ++t) {
+        threads.emplace_back([&] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            uint64_t own_reads = 0;
+            uint64_t own_bad = 0;
+            int64_t sum = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                sum += slot.Read(own_bad);
+                ++own_reads;
+            }
+            DoNotOptimize(sum);
+            reads.fetch_add(own_reads, std::memory_order_relaxed);
+            bad_reads.fetch_add(own_bad, std::memory_order_relaxed);
+        });
+    }
+
+    threads.emplace_back([&] {
+        while (!start.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        for (int64_t value = 1; !stop.load(std::memory_order_relaxed); ++value) {
+            slot.Write(value);
+        }
+    });
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    while (NowNs() - begin < kRunNs) {
+        std::this_thread::yield();
+    }
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t elapsed = NowNs() - begin;
+
+    return Result{static_cast<double>(reads.load()) * 1e3 / elapsed, bad_reads.load()};
+}
+
+class EpochSlot {
+    std::atomic<Node*> node_;
+
+public:
+    EpochSlot() : node_(new Node(0)) {
+    }
+
+    ~EpochSlot() {
+        delete node_.load();
+        EpochReclaimer::Flush();
+    }
+
+    int64_t Read(uint64_t& bad) {
+        EpochReclaimer::Guard guard;
+        Node* node = node_.load(std::memory_order_acquire);
+        bad += node->magic != kAlive;
+        return node->value;
+    }
+
+    void Write(int64_t value) {
+        Node* old = node_.exchange(new Node(value), std::memory_order_acq_rel);
+        EpochReclaimer::Retire(UniquePtr<Node>(old));
+    }
+};
+
+class HazardSlot {
+    std::atomic<Node*> node_;
+
+public:
+    HazardSlot() : node_(new Node(0)) {
+    }
+
+    ~HazardSlot() {
+        delete node_.load();
+        HazardPointers::Flush();
+    }
+
+    int64_t Read(uint64_t& bad) {
+        HazardPointers::Guard guard;
+        Node* node = guard.Protect(node_);
+        bad += node->magic != kAlive;
+        return node->value;
+    }
+
+    void Write(int64_t value) {
+        Node* old = node_.exchange(new Node(value), std::memory_order_acq_rel);
+        HazardPointers::Retire(UniquePtr<Node>(old));
+    }
+};
+
+class SharedPtrSlot {
+    AtomicSharedPtr<Node> node_;
+
+public:
+    SharedPtrSlot() : node_(SharedPtr<Node>(new Node(0))) {
+    }
+
+    int64_t Read(uint64_t& bad) {
+        SharedPtr<Node> node = node_.Load();
+        bad += node->magic != kAlive;
+        return node->value;
+    }
+
+    void Write(int64_t value) {
+        node_.Store(SharedPtr<Node>(new Node(value)));
+    }
+};
+
+void Report(BenchReport& report, const char* name, size_t readers, const Result& result) {
+    report.AddRate("read", name, readers, result.reads_per_us, "reads/us");
+    report.Add("bad_reads", name, readers, static_cast<double>(result.bad_reads), "reads");
+}
+
+// Size is the number of reader threads. Any bad read is a reclamation bug.
+int main(int argc, char** argv) {
+    BenchReport report("reclamation", argc, argv);
+    for (size_t readers = 1; readers <= 16; readers *= 2) {
+        Report(report, "epoch", readers, Run<EpochSlot>(readers));
+        Report(report, "hazard", readers, Run<HazardSlot>(readers));
+        Report(report, "shared_ptr", readers, Run<SharedPtrSlot>(readers));
+    }
+
+    // Nodes still pending belong to retire lists of threads that have exited.
+    report.Add("awaiting_reclamation", "all", 0, static_cast<double>(live_nodes.load()), "nodes");
+    return report.Write();
+}
@@ -0,0 +1,55 @@
+// Copy/destroy cost of SharedPtr under both reference-count policies.
+// "shared" has every thread copying the same pointer (one contended count);
+// "private" gives each thread its own pointer. NonAtomicRefCount is only
+// legal in the private setup.
+
+#include "../shared_and_weak_ptr.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <thread>
+
+const size_t kCopiesPerThread = 2000000;
+
+template <class Policy>
+double Run(size_t threads_count, bool shared) {
+    SharedPtr<int64_t, Policy> common = MakeShared<int64_t, Policy>(1);
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&] {
+            SharedPtr<int64_t, Policy> own = shared ? common : MakeShared<int64_t, Policy>(1);
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            int64_t sum = 0;
+            for (size_t i = 0; i < kCopiesPerThread; ++i) {
+                SharedPtr<int64_t, Policy> copy = own;
+                sum += *copy;
+            }
+            DoNotOptimize(sum);
+        });
+    }
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(NowNs() - begin) / (kCopiesPerThread * threads_count);
+}
+
+// Size is the number of threads.
+int main(int argc, char** argv) {
+    BenchReport report("refcount_policy", argc, argv);
+    report.Add("copy_private", "atomic", 1, Run<AtomicRefCount>(1, false), "ns/copy");
+    report.Add("copy_private", "non_atomic", 1, Run<NonAtomicRefCount>(1, false), "ns/copy");
+
+    for (size_t threads = 2; threads <= 64; threads *= 2) {
+        report.Add("copy_shared", "atomic", threads, Run<AtomicRefCount>(threads, true), "ns/copy");
+        report.Add("copy_private", "atomic", threads, Run<AtomicRefCount>(threads, false), "ns/copy");
+        report.Add("copy_private", "non_atomic", threads, Run<NonAtomicRefCount>(threads, false), "ns/copy");
+    }
+    return report.Write();
+}
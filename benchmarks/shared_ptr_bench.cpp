@@ -0,0 +1,116 @@
+// SharedPtr/WeakPtr against std::shared_ptr/std::weak_ptr across object
+// counts: MakeShared and destruction, refcount churn (copy and drop a random
+// pointer), WeakPtr creation and Lock() on live objects, and Lock() on
+// expired ones. Times are per operation.
+
+#include "../shared_and_weak_ptr.h"
+#include "bench_util.h"
+
+#include <memory>
+#include <vector>
+
+struct Payload {
+    int64_t value;
+
+    explicit Payload(int64_t value = 0) : value(value) {
+    }
+};
+
+struct Custom {
+    using Shared = SharedPtr<Payload>;
+    using Weak = WeakPtr<Payload>;
+
+    static Shared Make(int64_t value) {
+        return MakeShared<Payload>(value);
+    }
+
+    static Shared Lock(const Weak& weak) {
+        return weak.Lock();
+    }
+};
+
+struct Standard {
+    using Shared = std::shared_ptr<Payload>;
+    using Weak = std::weak_ptr<Payload>;
+
+    static Shared Make(int64_t value) {
+        return std::make_shared<Payload>(value);
+    }
+
+    static Shared Lock(const Weak& weak) {
+        return weak.lock();
+    }
+};
+
+template <class Impl>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    using Shared = typename Impl::Shared;
+    using Weak = typename Impl::Weak;
+    const size_t reps = Repetitions(size);
+
+    report.Add("make_destroy", impl, size, NsPerOp(size * reps, [&] {
+        std::vector<Shared> ptrs;
+        ptrs.reserve(size);
+        for (size_t rep = 0; rep < reps; ++rep) {
+            for (size_t i = 0; i < size; ++i) {
+                ptrs.push_back(Impl::Make(static_cast<int64_t>(i)));
+            }
+            DoNotOptimize(ptrs.back()->value);
+            ptrs.clear();
+        }
+    }));
+
+    std::vector<Shared> ptrs;
+    ptrs.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        ptrs.push_back(Impl::Make(static_cast<int64_t>(i)));
+    }
+
+    report.Add("copy_drop", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            Shared copy = ptrs[random.Below(size)];
+            sum += copy->value;
+        }
+        DoNotOptimize(sum);
+    }));
+
+    std::vector<Weak> weaks;
+    weaks.reserve(size);
+    report.Add("weak_create", impl, size, NsPerOp(size, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            weaks.push_back(Weak(ptrs[i]));
+        }
+        DoNotOptimize(weaks.back());
+    }));
+
+    report.Add("weak_lock", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            Shared locked = Impl::Lock(weaks[random.Below(size)]);
+            sum += locked->value;
+        }
+        DoNotOptimize(sum);
+    }));
+
+    ptrs.clear();
+    report.Add("weak_lock_expired", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        size_t empty = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            empty += !Impl::Lock(weaks[random.Below(size)]);
+        }
+        DoNotOptimize(empty);
+    }));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("shared_ptr", argc, argv);
+    for (size_t size : report.Sizes()) {
+        Run<Custom>(report, "SharedPtr", size);
+        Run<Standard>(report, "std::shared_ptr", size);
+    }
+    return report.Write();
+}
@@ -0,0 +1,76 @@
+// SharedPtr creation rate: create/destroy churn of SharedPtr(new T), whose
+// control block comes from ControlBlockPool, against the same pointer with a
+// custom deleter (block from std::allocator), MakeShared and the std::
+// equivalents. Each thread keeps a window of live pointers, so blocks are
+// recycled the way a real working set would recycle them.
+
+#include "../shared_and_weak_ptr.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+const size_t kCreatesPerThread = 1 << 20;
+const size_t kWindow = 1024;
+
+struct Payload {
+    int64_t value;
+
+    explicit Payload(int64_t value) : value(value) {
+    }
+};
+
+template <class Ptr, class Make>
+double Run(size_t threads_count, Make make) {
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&] {
+            std::vector<Ptr> window(kWindow);
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            int64_t sum = 0;
+            for (size_t i = 0; i < kCreatesPerThread; ++i) {
+                Ptr& slot = window[i % kWindow];
+                slot = make(static_cast<int64_t>(i));
+                sum += slot->value;
+            }
+            DoNotOptimize(sum);
+        });
+    }
+
+    uint64_t begin = NowNs();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(kCreatesPerThread * threads_count) * 1e3 / (NowNs() - begin);
+}
+
+// Size is the number of threads.
+int main(int argc, char** argv) {
+    BenchReport report("shared_ptr_create", argc, argv);
+    for (size_t threads = 1; threads <= 16; threads *= 2) {
+        double pooled = Run<SharedPtr<Payload>>(threads, [](int64_t v) { return SharedPtr<Payload>(new Payload(v)); });
+        double deleter = Run<SharedPtr<Payload>>(threads, [](int64_t v) {
+            return SharedPtr<Payload>(new Payload(v), [](Payload* p) { delete p; });
+        });
+        double make_shared = Run<SharedPtr<Payload>>(threads, [](int64_t v) { return MakeShared<Payload>(v); });
+        double std_new = Run<std::shared_ptr<Payload>>(threads, [](int64_t v) {
+            return std::shared_ptr<Payload>(new Payload(v));
+        });
+        double std_make_shared = Run<std::shared_ptr<Payload>>(threads, [](int64_t v) {
+            return std::make_shared<Payload>(v);
+        });
+
+        report.AddRate("create", "SharedPtr(new T)", threads, pooled, "Mcreates/s");
+        report.AddRate("create", "SharedPtr(new T, deleter)", threads, deleter, "Mcreates/s");
+        report.AddRate("create", "MakeShared", threads, make_shared, "Mcreates/s");
+        report.AddRate("create", "std::shared_ptr(new T)", threads, std_new, "Mcreates/s");
+        report.AddRate("create", "std::make_shared", threads, std_make_shared, "Mcreates/s");
+    }
+    return report.Write();
+}
@@ -0,0 +1,91 @@
+// String against std::string across lengths: building by push_back,
+// concatenation of short pieces with +=, random reads, copy construction and
+// equality of two equal strings. Times are per character.
+
+#include "../string.h"
+#include "bench_util.h"
+
+#include <string>
+
+const size_t kPieceLength = 16;
+
+void PushBack(String& str, char symbol) {
+    str.PushBack(symbol);
+}
+
+void PushBack(std::string& str, char symbol) {
+    str.push_back(symbol);
+}
+
+template <class S>
+S Filled(size_t size) {
+    S str;
+    for (size_t i = 0; i < size; ++i) {
+        PushBack(str, static_cast<char>('a' + i % 26));
+    }
+    return str;
+}
+
+template <class S>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    const size_t reps = Repetitions(size);
+
+    report.Add("push_back", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            S str;
+            for (size_t i = 0; i < size; ++i) {
+                PushBack(str, static_cast<char>('a' + i % 26));
+            }
+            DoNotOptimize(str[size - 1]);
+        }
+    }));
+
+    S piece = Filled<S>(kPieceLength);
+    const size_t pieces = size / kPieceLength > 0 ? size / kPieceLength : 1;
+    report.Add("concatenate", impl, size, NsPerOp(pieces * kPieceLength * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            S str;
+            for (size_t i = 0; i < pieces; ++i) {
+                str += piece;
+            }
+            DoNotOptimize(str[0]);
+        }
+    }));
+
+    S str = Filled<S>(size);
+    const S& view = str;
+
+    report.Add("random_read", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        size_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            sum += static_cast<unsigned char>(view[random.Below(size)]);
+        }
+        DoNotOptimize(sum);
+    }));
+
+    report.Add("copy", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            S copy(view);
+            DoNotOptimize(copy[size - 1]);
+        }
+    }));
+
+    S other(view);
+    report.Add("equal", impl, size, NsPerOp(size * reps, [&] {
+        size_t equal = 0;
+        for (size_t rep = 0; rep < reps; ++rep) {
+            equal += str == other;
+            DoNotOptimize(equal);
+        }
+    }));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("string", argc, argv);
+    for (size_t size : report.Sizes()) {
+        Run<String>(report, "String", size);
+        Run<std::string>(report, "std::string", size);
+    }
+    return report.Write();
+}
@@ -0,0 +1,106 @@
+// UniquePtr against std::unique_ptr across object counts: MakeUnique and
+// destruction, moving every pointer between two vectors, random dereference,
+// and MakeUnique<T[]> of size elements. Times are per object (per element
+// for the array).
+
+#include "../unique_ptr.h"
+#include "bench_util.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct Payload {
+    int64_t value;
+
+    explicit Payload(int64_t value = 0) : value(value) {
+    }
+};
+
+struct Custom {
+    template <class T>
+    using Ptr = UniquePtr<T>;
+
+    static Ptr<Payload> Make(int64_t value) {
+        return MakeUnique<Payload>(value);
+    }
+
+    static Ptr<int64_t[]> MakeArray(size_t size) {
+        return MakeUnique<int64_t[]>(size);
+    }
+};
+
+struct Standard {
+    template <class T>
+    using Ptr = std::unique_ptr<T>;
+
+    static Ptr<Payload> Make(int64_t value) {
+        return std::make_unique<Payload>(value);
+    }
+
+    static Ptr<int64_t[]> MakeArray(size_t size) {
+        return std::make_unique<int64_t[]>(size);
+    }
+};
+
+template <class Impl>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    using Ptr = typename Impl::template Ptr<Payload>;
+    const size_t reps = Repetitions(size);
+
+    report.Add("create_destroy", impl, size, NsPerOp(size * reps, [&] {
+        std::vector<Ptr> ptrs;
+        ptrs.reserve(size);
+        for (size_t rep = 0; rep < reps; ++rep) {
+            for (size_t i = 0; i < size; ++i) {
+                ptrs.push_back(Impl::Make(static_cast<int64_t>(i)));
+            }
+            DoNotOptimize(ptrs.back()->value);
+            ptrs.clear();
+        }
+    }));
+
+    std::vector<Ptr> ptrs;
+    std::vector<Ptr> other(size);
+    for (size_t i = 0; i < size; ++i) {
+        ptrs.push_back(Impl::Make(static_cast<int64_t>(i)));
+    }
+
+    report.Add("move", impl, size, NsPerOp(2 * size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            for (size_t i = 0; i < size; ++i) {
+                other[i] = std::move(ptrs[i]);
+            }
+            for (size_t i = 0; i < size; ++i) {
+                ptrs[i] = std::move(other[i]);
+            }
+            DoNotOptimize(ptrs[0]->value);
+        }
+    }));
+
+    report.Add("random_deref", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            sum += ptrs[random.Below(size)]->value;
+        }
+        DoNotOptimize(sum);
+    }));
+
+    report.Add("make_array", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            auto array = Impl::MakeArray(size);
+            array[size - 1] = static_cast<int64_t>(rep);
+            DoNotOptimize(array[size - 1]);
+        }
+    }));
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("unique_ptr", argc, argv);
+    for (size_t size : report.Sizes()) {
+        Run<Custom>(report, "UniquePtr", size);
+        Run<Standard>(report, "std::unique_ptr", size);
+    }
+    return report.Write();
+}
@@ -0,0 +1,131 @@
+// Vector against std::vector across sizes: growth by push_back, a push/pop
+// mix, sequential and random reads, copy construction, and an O(1) move
+// there and back (Swap for Vector, which has no move constructor; std::move
+// for std::vector). Times are per element unless the unit says otherwise.
+
+#include "../vector.h"
+#include "bench_util.h"
+
+#include <utility>
+#include <vector>
+
+using Custom = Vector<int64_t>;
+using Standard = std::vector<int64_t>;
+
+void PushBack(Custom& vector, int64_t value) {
+    vector.PushBack(value);
+}
+
+void PushBack(Standard& vector, int64_t value) {
+    vector.push_back(value);
+}
+
+void PopBack(Custom& vector) {
+    vector.PopBack();
+}
+
+void PopBack(Standard& vector) {
+    vector.pop_back();
+}
+
+size_t Size(const Custom& vector) {
+    return vector.Size();
+}
+
+size_t Size(const Standard& vector) {
+    return vector.size();
+}
+
+// Moves the contents out into a temporary and back.
+void RoundTrip(Custom& vector) {
+    Custom other;
+    other.Swap(vector);
+    vector.Swap(other);
+}
+
+void RoundTrip(Standard& vector) {
+    Standard other(std::move(vector));
+    vector = std::move(other);
+}
+
+template <class V>
+V Filled(size_t size) {
+    V vector;
+    for (size_t i = 0; i < size; ++i) {
+        PushBack(vector, static_cast<int64_t>(i));
+    }
+    return vector;
+}
+
+template <class V>
+void Run(BenchReport& report, const char* impl, size_t size) {
+    const size_t reps = Repetitions(size);
+
+    report.Add("push_back", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            V vector;
+            for (size_t i = 0; i < size; ++i) {
+                PushBack(vector, static_cast<int64_t>(i));
+            }
+            DoNotOptimize(vector[size - 1]);
+        }
+    }));
+
+    // Two pushes, one pop: the vector ends up at size elements.
+    report.Add("push_pop_mix", impl, size, NsPerOp(3 * size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            V vector;
+            for (size_t i = 0; i < size; ++i) {
+                PushBack(vector, static_cast<int64_t>(i));
+                PushBack(vector, static_cast<int64_t>(i));
+                PopBack(vector);
+            }
+            DoNotOptimize(vector[0]);
+        }
+    }));
+
+    V vector = Filled<V>(size);
+    const V& view = vector;
+
+    report.Add("sequential_read", impl, size, NsPerOp(size * reps, [&] {
+        int64_t sum = 0;
+        for (size_t rep = 0; rep < reps; ++rep) {
+            for (size_t i = 0; i < size; ++i) {
+                sum += view[i];
+            }
+            DoNotOptimize(sum);
+        }
+    }));
+
+    report.Add("random_read", impl, size, NsPerOp(size * reps, [&] {
+        FastRandom random;
+        int64_t sum = 0;
+        for (size_t i = 0; i < size * reps; ++i) {
+            sum += view[random.Below(size)];
+        }
+        DoNotOptimize(sum);
+    }));
+
+    report.Add("copy", impl, size, NsPerOp(size * reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            V copy(view);
+            DoNotOptimize(copy[size - 1]);
+        }
+    }));
+
+    report.Add("move_round_trip", impl, size, NsPerOp(reps, [&] {
+        for (size_t rep = 0; rep < reps; ++rep) {
+            RoundTrip(vector);
+            DoNotOptimize(Size(vector));
+        }
+    }), "ns/round_trip");
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("vector", argc, argv);
+    for (size_t size : report.Sizes()) {
+        Run<Custom>(report, "Vector", size);
+        Run<Standard>(report, "std::vector", size);
+    }
+    return report.Write();
+}
@@ -0,0 +1,422 @@
+#ifndef BTREE_MAP_H
+#define BTREE_MAP_H
+
+#include "memory_resource.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BTREE_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+//================ In-node search ================//
+
+// Number of keys in keys[0, count) that are less than key, i.e. the slot the
+// key goes to. The generic version is a branchless binary search; arithmetic
+// keys under std::less count with a straight loop (no data-dependent
+// branches, and the compiler may vectorize it); signed 32- and 64-bit
+// integers and doubles compare a whole register of keys per step.
+template <class K, class Compare, class = void>
+struct BTreeSearch {
+    static size_t CountLess(const K* keys, size_t count, const K& key, const Compare& less) {
+        if (count == 0) {
+            return 0;
+        }
+
+        const K* base = keys;
+        while (count > 1) {
+            size_t half = count / 2;
+            base = less(base[half], key) ? base + half : base;
+            count -= half;
+        }
+        return static_cast<size_t>(base - keys) + less(*base, key);
+    }
+};
+
+template <class K>
+struct BTreeSearch<K, std::less<K>, std::enable_if_t<std::is_arithmetic<K>::value>> {
+    static size_t CountLess(const K* keys, size_t count, const K& key, const std::less<K>&) {
+        size_t res = 0;
+        for (size_t i = 0; i < count; ++i) {
+            res += keys[i] < key;
+        }
+        return res;
+    }
+};
+
+#ifdef BTREE_MAP_SSE2
+
+template <>
+struct BTreeSearch<int32_t, std::less<int32_t>> {
+    static size_t CountLess(const int32_t* keys, size_t count, int32_t key, const std::less<int32_t>&) {
+        __m128i needle = _mm_set1_epi32(key);
+        size_t res = 0;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i less = _mm_cmpgt_epi32(needle, _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)));
+            res += static_cast<size_t>(__builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less))));
+        }
+        for (; i < count; ++i) {
+            res += keys[i] < key;
+        }
+        return res;
+    }
+};
+
+template <>
+struct BTreeSearch<double, std::less<double>> {
+    static size_t CountLess(const double* keys, size_t count, double key, const std::less<double>&) {
+        __m128d needle = _mm_set1_pd(key);
+        size_t res = 0;
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            __m128d less = _mm_cmplt_pd(_mm_loadu_pd(keys + i), needle);
+            res += static_cast<size_t>(__builtin_popcount(_mm_movemask_pd(less)));
+        }
+        for (; i < count; ++i) {
+            res += keys[i] < key;
+        }
+        return res;
+    }
+};
+
+#endif // BTREE_MAP_SSE2
+
+#ifdef __SSE4_2__
+
+// 64-bit signed compare arrived with SSE4.2.
+template <>
+struct BTreeSearch<int64_t, std::less<int64_t>> {
+    static size_t CountLess(const int64_t* keys, size_t count, int64_t key, const std::less<int64_t>&) {
+        __m128i needle = _mm_set1_epi64x(key);
+        size_t res = 0;
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            __m128i less = _mm_cmpgt_epi64(needle, _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)));
+            res += static_cast<size_t>(__builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(less))));
+        }
+        for (; i < count; ++i) {
+            res += keys[i] < key;
+        }
+        return res;
+    }
+};
+
+#endif // __SSE4_2__
+
+//================ BTreeMap ================//
+
+const static size_t kBTreeNodeBytes = 256;
+
+// B+ tree with nodes of about NodeBytes bytes, aligned to cache lines: a
+// node is read with a few sequential line fetches, and a lookup does one
+// in-node search (BTreeSearch) per level. Entries live only in the leaves,
+// which are chained in key order, so range iteration walks leaf arrays
+// front to back.
+//
+// An inner node with n keys has n + 1 children; child i holds the keys in
+// (keys[i - 1], keys[i]]. Full nodes are split on the way down during
+// Insert. Erase does not merge or rebalance: nodes stay allocated until
+// Clear, the destructor, or the last entry going away. K and V must be
+// default-constructible and assignable.
+template <class K, class V, class Compare = std::less<K>, size_t NodeBytes = kBTreeNodeBytes>
+class BTreeMap {
+    const static size_t kCacheLine = 64;
+    const static size_t kMinSlots = 4;
+
+    const static size_t kLeafFit = (NodeBytes - 2 * sizeof(void*) - sizeof(uint32_t)) / (sizeof(K) + sizeof(V));
+    const static size_t kInnerFit = (NodeBytes - sizeof(void*) - sizeof(uint32_t)) / (sizeof(K) + sizeof(void*));
+
+    const static size_t kLeafSlots = kLeafFit < kMinSlots ? kMinSlots : kLeafFit;
+    const static size_t kInnerSlots = kInnerFit < kMinSlots ? kMinSlots : kInnerFit;
+
+    struct alignas(kCacheLine) Leaf {
+        K keys[kLeafSlots];
+        V values[kLeafSlots];
+        Leaf* prev = nullptr;
+        Leaf* next = nullptr;
+        uint32_t count = 0;
+    };
+
+    // Children are Inner* above the lowest inner level and Leaf* on it; the
+    // tree's height says which.
+    struct alignas(kCacheLine) Inner {
+        K keys[kInnerSlots];
+        void* children[kInnerSlots + 1];
+        uint32_t count = 0;
+    };
+
+    void* root_;
+    size_t height_;  // inner levels above the leaves
+    size_t size_;
+    Leaf* first_leaf_;
+    MemoryResource* resource_;
+    Compare less_;
+
+    size_t CountLess(const K* keys, size_t count, const K& key) const {
+        return BTreeSearch<K, Compare>::CountLess(keys, count, key, less_);
+    }
+
+    Leaf* FindLeaf(const K& key) const {
+        void* node = root_;
+        for (size_t level = height_; level > 0; --level) {
+            Inner* inner = static_cast<Inner*>(node);
+            node = inner->children[CountLess(inner->keys, inner->count, key)];
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    void FreeNode(void* node, size_t level) {
+        if (level == 0) {
+            DeleteObject(resource_, static_cast<Leaf*>(node));
+            return;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        for (size_t i = 0; i <= inner->count; ++i) {
+            FreeNode(inner->children[i], level - 1);
+        }
+        DeleteObject(resource_, inner);
+    }
+
+    bool Full(void* node, size_t level) const {
+        return level == 0 ? static_cast<Leaf*>(node)->count == kLeafSlots
+                          : static_cast<Inner*>(node)->count == kInnerSlots;
+    }
+
+    // Adds separator before children[idx + 1] of a non-full inner node.
+    static void InsertChild(Inner* parent, size_t idx, const K& separator, void* child) {
+        for (size_t i = parent->count; i > idx; --i) {
+            parent->keys[i] = std::move(parent->keys[i - 1]);
+            parent->children[i + 1] = parent->children[i];
+        }
+        parent->keys[idx] = separator;
+        parent->children[idx + 1] = child;
+        ++parent->count;
+    }
+
+    // Splits the full children[idx] of a non-full parent in two.
+    void SplitChild(Inner* parent, size_t idx, size_t child_level) {
+        if (child_level == 0) {
+            Leaf* left = static_cast<Leaf*>(parent->children[idx]);
+            Leaf* right = NewObject<Leaf>(resource_);
+            size_t mid = kLeafSlots / 2;
+            for (size_t i = mid; i < kLeafSlots; ++i) {
+                right->keys[i - mid] = std::move(left->keys[i]);
+                right->values[i - mid] = std::move(left->values[i]);
+            }
+            right->count = static_cast<uint32_t>(kLeafSlots - mid);
+            left->count = static_cast<uint32_t>(mid);
+
+            right->prev = left;
+            right->next = left->next;
+            if (left->next != nullptr) {
+                left->next->prev = right;
+            }
+            left->next = right;
+            InsertChild(parent, idx, left->keys[mid - 1], right);
+            return;
+        }
+
+        // keys[mid] moves up; the halves keep the keys on either side of it.
+        Inner* left = static_cast<Inner*>(parent->children[idx]);
+        Inner* right = NewObject<Inner>(resource_);
+        size_t mid = kInnerSlots / 2;
+        for (size_t i = mid + 1; i < kInnerSlots; ++i) {
+            right->keys[i - mid - 1] = std::move(left->keys[i]);
+        }
+        for (size_t i = mid + 1; i <= kInnerSlots; ++i) {
+            right->children[i - mid - 1] = left->children[i];
+        }
+        right->count = static_cast<uint32_t>(kInnerSlots - mid - 1);
+        left->count = static_cast<uint32_t>(mid);
+        InsertChild(parent, idx, left->keys[mid], right);
+    }
+
+    // Returns the leaf that holds or should hold key, splitting every full
+    // node on the path so that the leaf has room for one more entry.
+    Leaf* PrepareInsert(const K& key) {
+        if (root_ == nullptr) {
+            first_leaf_ = NewObject<Leaf>(resource_);
+            root_ = first_leaf_;
+        }
+
+        if (Full(root_, height_)) {
+            Inner* root = NewObject<Inner>(resource_);
+            root->children[0] = root_;
+            root_ = root;
+            ++height_;
+            SplitChild(root, 0, height_ - 1);
+        }
+
+        void* node = root_;
+        for (size_t level = height_; level > 0; --level) {
+            Inner* inner = static_cast<Inner*>(node);
+            size_t idx = CountLess(inner->keys, inner->count, key);
+            if (Full(inner->children[idx], level - 1)) {
+                SplitChild(inner, idx, level - 1);
+                if (less_(inner->keys[idx], key)) {
+                    ++idx;
+                }
+            }
+            node = inner->children[idx];
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    // Finds or adds key; the bool is true if it was added.
+    std::pair<V*, bool> Emplace(const K& key, const V& value) {
+        if (root_ != nullptr) {
+            Leaf* leaf = FindLeaf(key);
+            size_t idx = CountLess(leaf->keys, leaf->count, key);
+            if (idx < leaf->count && !less_(key, leaf->keys[idx])) {
+                return {&leaf->values[idx], false};
+            }
+        }
+
+        Leaf* leaf = PrepareInsert(key);
+        size_t idx = CountLess(leaf->keys, leaf->count, key);
+        for (size_t i = leaf->count; i > idx; --i) {
+            leaf->keys[i] = std::move(leaf->keys[i - 1]);
+            leaf->values[i] = std::move(leaf->values[i - 1]);
+        }
+        leaf->keys[idx] = key;
+        leaf->values[idx] = value;
+        ++leaf->count;
+        ++size_;
+        return {&leaf->values[idx], true};
+    }
+
+public:
+    BTreeMap() : BTreeMap(DefaultResource()) {
+    }
+
+    explicit BTreeMap(MemoryResource* resource)
+            : root_(nullptr), height_(0), size_(0), first_leaf_(nullptr), resource_(resource) {
+    }
+
+    BTreeMap(const BTreeMap&) = delete;
+    BTreeMap& operator=(const BTreeMap&) = delete;
+
+    ~BTreeMap() {
+        Clear();
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    MemoryResource* Resource() const {
+        return resource_;
+    }
+
+    // Entries per leaf and keys per inner node for these template arguments.
+    static size_t LeafSlots() {
+        return kLeafSlots;
+    }
+
+    static size_t InnerSlots() {
+        return kInnerSlots;
+    }
+
+    void Clear() {
+        if (root_ != nullptr) {
+            FreeNode(root_, height_);
+        }
+        root_ = nullptr;
+        height_ = 0;
+        size_ = 0;
+        first_leaf_ = nullptr;
+    }
+
+    V* Find(const K& key) {
+        if (root_ == nullptr) {
+            return nullptr;
+        }
+        Leaf* leaf = FindLeaf(key);
+        size_t idx = CountLess(leaf->keys, leaf->count, key);
+        return idx < leaf->count && !less_(key, leaf->keys[idx]) ? &leaf->values[idx] : nullptr;
+    }
+
+    const V* Find(const K& key) const {
+        return const_cast<BTreeMap*>(this)->Find(key);
+    }
+
+    bool Contains(const K& key) const {
+        return Find(key) != nullptr;
+    }
+
+    // False (and no change) if the key is already present.
+    bool Insert(const K& key, const V& value) {
+        return Emplace(key, value).second;
+    }
+
+    V& operator[](const K& key) {
+        return *Emplace(key, V()).first;
+    }
+
+    // False if the key was not there.
+    bool Erase(const K& key) {
+        if (root_ == nullptr) {
+            return false;
+        }
+
+        Leaf* leaf = FindLeaf(key);
+        size_t idx = CountLess(leaf->keys, leaf->count, key);
+        if (idx == leaf->count || less_(key, leaf->keys[idx])) {
+            return false;
+        }
+        for (size_t i = idx + 1; i < leaf->count; ++i) {
+            leaf->keys[i - 1] = std::move(leaf->keys[i]);
+            leaf->values[i - 1] = std::move(leaf->values[i]);
+        }
+        --leaf->count;
+        if (--size_ == 0) {
+            Clear();
+        }
+        return true;
+    }
+
+    // Calls visit(const K&, V&) for every key in [from, to), in order.
+    template <class Visit>
+    void ForEachInRange(const K& from, const K& to, Visit visit) {
+        if (root_ == nullptr) {
+            return;
+        }
+
+        Leaf* leaf = FindLeaf(from);
+        size_t idx = CountLess(leaf->keys, leaf->count, from);
+        for (; leaf != nullptr; leaf = leaf->next, idx = 0) {
+            for (; idx < leaf->count; ++idx) {
+                if (!less_(leaf->keys[idx], to)) {
+                    return;
+                }
+                visit(static_cast<const K&>(leaf->keys[idx]), leaf->values[idx]);
+            }
+        }
+    }
+
+    template <class Visit>
+    void ForEach(Visit visit) {
+        for (Leaf* leaf = first_leaf_; leaf != nullptr; leaf = leaf->next) {
+            for (size_t idx = 0; idx < leaf->count; ++idx) {
+                visit(static_cast<const K&>(leaf->keys[idx]), leaf->values[idx]);
+            }
+        }
+    }
+};
+
+#endif // BTREE_MAP_H
@@ -0,0 +1,180 @@
+#ifndef CONTROL_BLOCK_POOL_H
+#define CONTROL_BLOCK_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Slab pool for SharedPtr control blocks, which all share one small size.
+// Each thread allocates from and frees into its own free list without any
+// synchronization; lists that grow too long are handed to a global lock-free
+// stack as whole batches, and an empty list takes a batch back or carves a
+// new slab. Slabs are never returned to the system, which is also what makes
+// the optimistic read in PopBatch() safe.
+class ControlBlockPool {
+public:
+    const static size_t kBlockSize = 4 * sizeof(void*);
+
+private:
+    const static size_t kBatchSize = 128;
+    const static size_t kCacheLimit = 2 * kBatchSize;
+    // A slab is a link to the previous slab followed by exactly one batch.
+    const static size_t kSlabSize = (kBatchSize + 1) * kBlockSize;
+
+    const static int kTagShift = 48;
+    const static uintptr_t kTagOne = uintptr_t(1) << kTagShift;
+    const static uintptr_t kPointerMask = kTagOne - 1;
+
+    struct FreeBlock {
+        FreeBlock* next;
+        FreeBlock* next_batch;
+        size_t batch_count;
+    };
+
+    static_assert(sizeof(FreeBlock) <= kBlockSize, "a free block must fit into a control block");
+
+    // Trivial, so it can still be used while the thread is being torn down.
+    struct ThreadCache {
+        FreeBlock* head;
+        size_t count;
+        bool exited;
+    };
+
+    struct ThreadExitFlusher {
+        ~ThreadExitFlusher() {
+            ThreadCache& cache = Cache();
+            if (cache.head != nullptr) {
+                PushBatch(cache.head, cache.count);
+            }
+            cache.head = nullptr;
+            cache.count = 0;
+            cache.exited = true;
+        }
+    };
+
+    // All slabs ever carved. Never walked; it keeps them reachable for leak
+    // checkers, which cannot see through the tagged batch stack.
+    static std::atomic<void*>& Slabs() {
+        static std::atomic<void*> slabs(nullptr);
+        return slabs;
+    }
+
+    // Top of the batch stack; the upper 16 bits are an ABA tag.
+    static std::atomic<uintptr_t>& Batches() {
+        static std::atomic<uintptr_t> batches(0);
+        return batches;
+    }
+
+    static ThreadCache& Cache() {
+        static thread_local ThreadCache cache = {nullptr, 0, false};
+        return cache;
+    }
+
+    static void RegisterFlusher() {
+        static thread_local ThreadExitFlusher flusher;
+        (void)flusher;
+    }
+
+    static FreeBlock* Unpack(uintptr_t packed) {
+        return reinterpret_cast<FreeBlock*>(packed & kPointerMask);
+    }
+
+    static void PushBatch(FreeBlock* batch, size_t count) {
+        batch->batch_count = count;
+        std::atomic<uintptr_t>& top = Batches();
+        uintptr_t old = top.load(std::memory_order_relaxed);
+        uintptr_t desired;
+        do {
+            batch->next_batch = Unpack(old);
+            desired = reinterpret_cast<uintptr_t>(batch) | ((old & ~kPointerMask) + kTagOne);
+        } while (!top.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    static FreeBlock* PopBatch() {
+        std::atomic<uintptr_t>& top = Batches();
+        uintptr_t old = top.load(std::memory_order_acquire);
+        while (Unpack(old) != nullptr) {
+            // May read a block that another thread has popped and reused;
+            // the memory is still mapped and the tag makes the CAS fail.
+            FreeBlock* next = Unpack(old)->next_batch;
+            uintptr_t desired = reinterpret_cast<uintptr_t>(next) | ((old & ~kPointerMask) + kTagOne);
+            if (top.compare_exchange_weak(old, desired, std::memory_order_acquire, std::memory_order_acquire)) {
+                return Unpack(old);
+            }
+        }
+        return nullptr;
+    }
+
+    static void Refill(ThreadCache& cache) {
+        FreeBlock* batch = PopBatch();
+        if (batch != nullptr) {
+            cache.head = batch;
+            cache.count = batch->batch_count;
+            return;
+        }
+
+        unsigned char* slab = static_cast<unsigned char*>(::operator new(kSlabSize));
+        void** previous = reinterpret_cast<void**>(slab);
+        *previous = Slabs().load(std::memory_order_relaxed);
+        while (!Slabs().compare_exchange_weak(*previous, slab, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+
+        for (size_t i = kBatchSize; i > 0; --i) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * kBlockSize);
+            block->next = cache.head;
+            cache.head = block;
+        }
+        cache.count = kBatchSize;
+    }
+
+public:
+    static void* Allocate() {
+        ThreadCache& cache = Cache();
+        if (cache.head == nullptr) {
+            RegisterFlusher();
+            Refill(cache);
+        }
+
+        FreeBlock* block = cache.head;
+        cache.head = block->next;
+        --cache.count;
+        return block;
+    }
+
+    static void Deallocate(void* ptr) {
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        ThreadCache& cache = Cache();
+
+        if (cache.exited) {
+            block->next = nullptr;
+            PushBatch(block, 1);
+            return;
+        }
+        if (cache.head == nullptr) {
+            // A thread may only ever free blocks that others allocated.
+            RegisterFlusher();
+        }
+
+        block->next = cache.head;
+        cache.head = block;
+        ++cache.count;
+
+        if (cache.count < kCacheLimit) {
+            return;
+        }
+
+        // Keep the newest blocks (cache-warm) and hand off the rest.
+        const size_t kept = kCacheLimit - kBatchSize;
+        FreeBlock* last_kept = cache.head;
+        for (size_t i = 1; i < kept; ++i) {
+            last_kept = last_kept->next;
+        }
+        FreeBlock* batch = last_kept->next;
+        last_kept->next = nullptr;
+        PushBatch(batch, cache.count - kept);
+        cache.count = kept;
+    }
+};
+
+#endif // CONTROL_BLOCK_POOL_H
@@ -1,43 +1,95 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include "instrumentation.h"
+#include "memory_resource.h"
+#include "utility.h"
+
 #include <cstddef>
+#include <new>
+#include <utility>
 
 //================ Page ================//
 
+// Elements live in uninitialized storage: a page costs no constructor calls
+// when allocated, T need not be default-constructible, and popped elements
+// are destroyed right away.
 template <class T, size_t N>
 class Page {
-    T buffer_[N];
+    alignas(T) unsigned char storage_[N * sizeof(T)];
     size_t size_;
     size_t begin_;
 
+    T* Slot(size_t idx) {
+        return std::launder(reinterpret_cast<T*>(storage_)) + idx;
+    }
+
+    const T* Slot(size_t idx) const {
+        return std::launder(reinterpret_cast<const T*>(storage_)) + idx;
+    }
+
+    void CopyFrom(const Page& other) {
+        begin_ = other.begin_;
+        for (size_t i = 0; i < other.size_; ++i) {
+            new (Slot(begin_ + i)) T(other[i]);
+            ++size_;
+        }
+    }
+
 public:
     Page() : size_(0), begin_(0) {
     }
 
-    Page(const Page& other) = default;
-    Page& operator=(const Page& other) = default;
-    ~Page() = default;
+    Page(const Page& other) : Page() {
+        try {
+            CopyFrom(other);
+        } catch (...) {
+            Clear();
+            throw;
+        }
+    }
+
+    Page& operator=(const Page& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        Clear();
+        try {
+            CopyFrom(other);
+        } catch (...) {
+            Clear();
+            throw;
+        }
+        return *this;
+    }
+
+    ~Page() {
+        Clear();
+    }
 
     T& operator[](size_t idx) {
-        return buffer_[begin_ + idx];
+        return *Slot(begin_ + idx);
     }
 
     const T& operator[](size_t idx) const {
-        return buffer_[begin_ + idx];
+        return *Slot(begin_ + idx);
     }
 
     const T& Front() const {
-        return buffer_[begin_];
+        return *Slot(begin_);
     }
 
     T& Front() {
-        return buffer_[begin_];
+        return *Slot(begin_);
     }
 
     const T& Back() const {
-        return buffer_[begin_ + size_ - 1];
+        return *Slot(begin_ + size_ - 1);
     }
 
     T& Back() {
-        return buffer_[begin_ + size_ - 1];
+        return *Slot(begin_ + size_ - 1);
     }
 
     bool Empty() const {
@@ -52,15 +104,18 @@ public:
         return Size() == N;
     }
 
+    // Room behind the last element / before the first one.
     bool IsBack() const {
-        return Empty() || (begin_ == 0 && !Full());
+        return Empty() || begin_ + size_ < N;
     }
 
     bool IsFront() const {
-        return Empty() || (begin_ != 0 && !Full());
+        return Empty() || begin_ > 0;
     }
 
-    void PushBack(const T& val) {
+    // If the constructor throws, the page is left unchanged.
+    template <class... Args>
+    void EmplaceBack(Args&&... args) {
         if (!IsBack()) {
             return;
         }
@@ -69,10 +124,12 @@ public:
             begin_ = 0;
         }
 
-        buffer_[size_++] = val;
+        new (Slot(begin_ + size_)) T(std::forward<Args>(args)...);
+        ++size_;
     }
 
-    void PushFront(const T& val) {
+    template <class... Args>
+    void EmplaceFront(Args&&... args) {
         if (!IsFront()) {
             return;
         }
@@ -81,15 +138,78 @@ public:
             begin_ = N;
         }
 
-        buffer_[--begin_] = val;
+        new (Slot(begin_ - 1)) T(std::forward<Args>(args)...);
+        --begin_;
         ++size_;
     }
 
+    void PushBack(const T& val) {
+        EmplaceBack(val);
+    }
+
+    void PushBack(T&& val) {
+        EmplaceBack(std::move(val));
+    }
+
+    void PushFront(const T& val) {
+        EmplaceFront(val);
+    }
+
+    void PushFront(T&& val) {
+        EmplaceFront(std::move(val));
+    }
+
+    // Copies as much of [first, last) as fits behind the last element and
+    // returns the first element that did not fit.
+    template <class It>
+    It Append(It first, It last) {
+        if (!IsBack()) {
+            return first;
+        }
+
+        if (Empty()) {
+            begin_ = 0;
+        }
+
+        while (first != last && begin_ + size_ < N) {
+            new (Slot(begin_ + size_)) T(*first);
+            ++size_;
+            ++first;
+        }
+
+        return first;
+    }
+
+    // Copies the tail of [first, last) in front of the first element, as much
+    // as fits, and returns the end of the part that did not fit.
+    template <class It>
+    It Prepend(It first, It last) {
+        if (!IsFront()) {
+            return last;
+        }
+
+        if (Empty()) {
+            begin_ = N;
+        }
+
+        while (last != first && begin_ > 0) {
+            It prev = last;
+            --prev;
+            new (Slot(begin_ - 1)) T(*prev);
+            last = prev;
+            --begin_;
+            ++size_;
+        }
+
+        return last;
+    }
+
     void PopBack() {
         if (Empty()) {
             return;
         }
 
+        Back().~T();
         --size_;
     }
 
@@ -98,24 +218,20 @@ public:
             return;
         }
 
+        Front().~T();
         --size_;
         ++begin_;
     }
 
     void Clear() {
-        size_ = 0;
+        while (!Empty()) {
+            PopBack();
+        }
     }
 };
 
 //================ CircularBuffer ================//
 
-template <class U>
-void Swap(U& a, U& b) {
-    U c = a;
-    a = b;
-    b = c;
-}
-
 template <class U>
 class CircularBuffer {
     U* buffer_;
@@ -123,6 +239,7 @@ class CircularBuffer {
     size_t begin_;
     size_t end_;
     size_t size_;
+    MemoryResource* resource_;
 
     const static int kIncreaseFactor = 2;
 
@@ -135,19 +252,25 @@ class CircularBuffer {
     }
 
 public:
-    CircularBuffer()
+    CircularBuffer() : CircularBuffer(DefaultResource()) {
+    }
+
+    explicit CircularBuffer(MemoryResource* resource)
             : buffer_(nullptr),
               capacity_(0),
               begin_(0),
               end_(0),
-              size_(0) {
+              size_(0),
+              resource_(resource) {
     }
 
-    explicit CircularBuffer(size_t count) : CircularBuffer() {
-        capacity_ = count;
-        if (count != 0) {
-            buffer_ = new U[count];
+    explicit CircularBuffer(size_t count, MemoryResource* resource = DefaultResource())
+            : CircularBuffer(resource) {
+        if (count > 0) {
+            CONTAINERS_RECORD_ALLOCATION(kCircularBuffer, count * sizeof(U));
         }
+        buffer_ = NewArray<U>(resource_, count);
+        capacity_ = count;
     }
 
     CircularBuffer(const CircularBuffer& other)
@@ -161,10 +284,18 @@ public:
         }
 
         Copy(other);
+        return *this;
     }
 
     ~CircularBuffer() {
-        delete[] buffer_;
+        if (buffer_ != nullptr) {
+            CONTAINERS_RECORD_DEALLOCATION(kCircularBuffer, capacity_ * sizeof(U));
+        }
+        DeleteArray(resource_, buffer_, capacity_);
+    }
+
+    MemoryResource* Resource() const {
+        return resource_;
     }
 
     U& operator[](size_t idx) {
@@ -219,6 +350,7 @@ public:
 
         buffer_[begin_] = val;
         ++size_;
+        CONTAINERS_RECORD_SIZE(kCircularBuffer, Size() * sizeof(U));
     }
 
     void PushBack(const U& val) {
@@ -237,6 +369,7 @@ public:
 
         buffer_[end_] = val;
         ++size_;
+        CONTAINERS_RECORD_SIZE(kCircularBuffer, Size() * sizeof(U));
     }
 
     void PopBack() {
@@ -263,17 +396,22 @@ public:
             return;
         }
 
-        U* new_buffer = new U[new_cap];
+        CONTAINERS_RECORD_ALLOCATION(kCircularBuffer, new_cap * sizeof(U));
+        U* new_buffer = NewArray<U>(resource_, new_cap);
         for (size_t i = 0; i < Size(); ++i) {
             new_buffer[i] = buffer_[(begin_ + i) % Capacity()];
         }
+        CONTAINERS_RECORD_REALLOCATION(kCircularBuffer, Size() * sizeof(U), new_cap * sizeof(U));
+
+        if (buffer_ != nullptr) {
+            CONTAINERS_RECORD_DEALLOCATION(kCircularBuffer, capacity_ * sizeof(U));
+        }
+        DeleteArray(resource_, buffer_, capacity_);
+        buffer_ = new_buffer;
 
         capacity_ = new_cap;
         begin_ = 0;
         end_ = begin_ + Size() - 1;
-
-        delete[] buffer_;
-        buffer_ = new_buffer;
     }
 
     void Swap(CircularBuffer<U>& other) {
@@ -282,21 +420,83 @@ public:
         ::Swap(begin_, other.begin_);
         ::Swap(end_, other.end_);
         ::Swap(size_, other.size_);
+        ::Swap(resource_, other.resource_);
     }
 };
 
 //================ Deque ================//
 
-template <class T>
+const static size_t kDequePageBytes = 4096;
+
+// Elements per page: the largest power of two whose page still fits into
+// PageBytes (at least one element), so that indexing is a shift and a mask.
+template <class T, size_t PageBytes = kDequePageBytes>
+constexpr size_t DequePageSize() {
+    size_t size = 1;
+    while (size * 2 * sizeof(T) <= PageBytes) {
+        size *= 2;
+    }
+    return size;
+}
+
+constexpr size_t Log2(size_t value) {
+    size_t res = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++res;
+    }
+    return res;
+}
+
+template <class T, size_t PageSize = DequePageSize<T>()>
 class Deque {
-    const static size_t kPageSize = 100;
+    static_assert(PageSize != 0 && (PageSize & (PageSize - 1)) == 0, "Deque page size must be a power of two");
+
+    const static size_t kPageSize = PageSize;
+    const static size_t kPageShift = Log2(PageSize);
+    const static size_t kPageMask = PageSize - 1;
 
+    // Pages and the page table share the table's resource.
     CircularBuffer<Page<T, kPageSize>*> cb_;
 
+    Page<T, kPageSize>* NewPage() {
+        CONTAINERS_RECORD_ALLOCATION(kDequePage, sizeof(Page<T, kPageSize>));
+        return NewObject<Page<T, kPageSize>>(cb_.Resource());
+    }
+
+    void DeletePage(Page<T, kPageSize>* page) {
+        CONTAINERS_RECORD_DEALLOCATION(kDequePage, sizeof(Page<T, kPageSize>));
+        DeleteObject(cb_.Resource(), page);
+    }
+
+    void DropEmptyBack() {
+        if (!cb_.Empty() && cb_.Back()->Empty()) {
+            DeletePage(cb_.Back());
+            cb_.PopBack();
+        }
+    }
+
+    void DropEmptyFront() {
+        if (!cb_.Empty() && cb_.Front()->Empty()) {
+            DeletePage(cb_.Front());
+            cb_.PopFront();
+        }
+    }
+
 public:
     Deque() : cb_() {
     }
 
+    explicit Deque(MemoryResource* resource) : cb_(resource) {
+    }
+
+    Deque(const Deque& other, MemoryResource* resource) : Deque(resource) {
+        size_t size_deque = other.Size();
+        for (size_t i = 0; i < size_deque; ++i) {
+            PushBack(other[i]);
+        }
+    }
+
     Deque(const Deque& other) : Deque() {
         size_t size_deque = other.Size();
         for (size_t i = 0; i < size_deque; ++i) {
@@ -304,74 +504,266 @@ public:
         }
     }
 
+    Deque(Deque&& other) noexcept : Deque() {
+        Swap(other);
+    }
+
     Deque& operator=(const Deque& other) {
         if (&other == this) {
             return *this;
         }
 
-        for (size_t i = 0; i < cb_.Size(); ++i) {
-            delete cb_[i];
-        }
-
-        cb_.Clear();
+        Deque tmp(other, Resource());
+        Swap(tmp);
+        return *this;
+    }
 
-        size_t size_deque = other.Size();
-        for (size_t i = 0; i < size_deque; ++i) {
-            PushBack(other[i]);
+    Deque& operator=(Deque&& other) noexcept {
+        if (&other == this) {
+            return *this;
         }
+
+        Deque tmp(std::move(other));
+        Swap(tmp);
+        return *this;
     }
 
     ~Deque() {
         for (size_t i = 0; i < cb_.Size(); ++i) {
-            delete cb_[i];
+            DeletePage(cb_[i]);
         }
     }
 
+    MemoryResource* Resource() const {
+        return cb_.Resource();
+    }
+
     T& operator[](size_t idx) {
-        if (idx < cb_.Front()->Size()) {
+        size_t front_size = cb_.Front()->Size();
+        if (idx < front_size) {
             return (*cb_.Front())[idx];
         }
 
-        size_t page_idx = (idx - cb_.Front()->Size()) / kPageSize;
-        return (*cb_[page_idx + 1])[(idx - cb_.Front()->Size()) % kPageSize];
+        idx -= front_size;
+        return (*cb_[(idx >> kPageShift) + 1])[idx & kPageMask];
     }
 
     const T& operator[](size_t idx) const {
-        if (idx < cb_.Front()->Size()) {
+        size_t front_size = cb_.Front()->Size();
+        if (idx < front_size) {
             return (*cb_.Front())[idx];
-        } else {
-            size_t page_idx = (idx - cb_.Front()->Size()) / kPageSize;
-            return (*cb_[page_idx + 1])[(idx - cb_.Front()->Size()) % kPageSize];
         }
+
+        idx -= front_size;
+        return (*cb_[(idx >> kPageShift) + 1])[idx & kPageMask];
     }
 
+    // Only the edge pages can be partly filled (operator[] relies on it too).
     size_t Size() const {
-        size_t res = 0;
-        for (size_t i = 0; i < cb_.Size(); ++i) {
-            res += cb_[i]->Size();
+        if (cb_.Empty()) {
+            return 0;
+        }
+        if (cb_.Size() == 1) {
+            return cb_.Front()->Size();
         }
 
-        return res;
+        return cb_.Front()->Size() + (cb_.Size() - 2) * PageSize + cb_.Back()->Size();
     }
 
     void Swap(Deque& other) {
         cb_.Swap(other.cb_);
     }
 
-    void PushBack(const T& value) {
-        if (cb_.Empty() || !(cb_.Back()->IsBack())) {
-            cb_.PushBack(new Page<T, kPageSize>);
+    // A page allocated for the new element is released again if the
+    // element's constructor throws.
+    template <class... Args>
+    void EmplaceBack(Args&&... args) {
+        if (!cb_.Empty() && cb_.Back()->IsBack()) {
+            cb_.Back()->EmplaceBack(std::forward<Args>(args)...);
+        } else {
+            Page<T, kPageSize>* page = NewPage();
+            try {
+                page->EmplaceBack(std::forward<Args>(args)...);
+                cb_.PushBack(page);
+            } catch (...) {
+                DeletePage(page);
+                throw;
+            }
         }
+        CONTAINERS_RECORD_SIZE(kDequePage, Size() * sizeof(T));
+    }
 
-        cb_.Back()->PushBack(value);
+    template <class... Args>
+    void EmplaceFront(Args&&... args) {
+        if (!cb_.Empty() && cb_.Front()->IsFront()) {
+            cb_.Front()->EmplaceFront(std::forward<Args>(args)...);
+        } else {
+            Page<T, kPageSize>* page = NewPage();
+            try {
+                page->EmplaceFront(std::forward<Args>(args)...);
+                cb_.PushFront(page);
+            } catch (...) {
+                DeletePage(page);
+                throw;
+            }
+        }
+        CONTAINERS_RECORD_SIZE(kDequePage, Size() * sizeof(T));
+    }
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
     }
 
     void PushFront(const T& value) {
-        if (cb_.Empty() || !(cb_.Front()->IsFront())) {
-            cb_.PushFront(new Page<T, kPageSize>);
+        EmplaceFront(value);
+    }
+
+    void PushFront(T&& value) {
+        EmplaceFront(std::move(value));
+    }
+
+    // Fills whole pages at a time instead of going element by element.
+    template <class It>
+    void Append(It first, It last) {
+        while (first != last) {
+            if (cb_.Empty() || !(cb_.Back()->IsBack())) {
+                Page<T, kPageSize>* page = NewPage();
+                try {
+                    cb_.PushBack(page);
+                } catch (...) {
+                    DeletePage(page);
+                    throw;
+                }
+            }
+
+            try {
+                first = cb_.Back()->Append(first, last);
+            } catch (...) {
+                DropEmptyBack();
+                throw;
+            }
+        }
+        CONTAINERS_RECORD_SIZE(kDequePage, Size() * sizeof(T));
+    }
+
+    // Puts [first, last) in front of the deque, keeping the range's order.
+    // Needs bidirectional iterators: pages are filled from the range's end.
+    template <class It>
+    void Prepend(It first, It last) {
+        while (first != last) {
+            if (cb_.Empty() || !(cb_.Front()->IsFront())) {
+                Page<T, kPageSize>* page = NewPage();
+                try {
+                    cb_.PushFront(page);
+                } catch (...) {
+                    DeletePage(page);
+                    throw;
+                }
+            }
+
+            try {
+                last = cb_.Front()->Prepend(first, last);
+            } catch (...) {
+                DropEmptyFront();
+                throw;
+            }
+        }
+        CONTAINERS_RECORD_SIZE(kDequePage, Size() * sizeof(T));
+    }
+
+    // Insert and Erase shift whichever side of pos is shorter, so at most
+    // half of the elements move.
+    void Insert(size_t pos, const T& value) {
+        size_t size = Size();
+        if (pos == 0) {
+            PushFront(value);
+            return;
+        }
+        if (pos == size) {
+            PushBack(value);
+            return;
+        }
+
+        T copy = value;
+        if (pos < size - pos) {
+            PushFront((*this)[0]);
+            for (size_t i = 1; i < pos; ++i) {
+                (*this)[i] = std::move((*this)[i + 1]);
+            }
+        } else {
+            PushBack((*this)[size - 1]);
+            for (size_t i = size - 1; i > pos; --i) {
+                (*this)[i] = std::move((*this)[i - 1]);
+            }
         }
 
-        cb_.Front()->PushFront(value);
+        (*this)[pos] = std::move(copy);
+    }
+
+    // Needs forward iterators that do not point into this deque.
+    template <class It>
+    void Insert(size_t pos, It first, It last) {
+        size_t count = 0;
+        for (It it = first; it != last; ++it) {
+            ++count;
+        }
+
+        if (count == 0) {
+            return;
+        }
+
+        size_t size = Size();
+        if (pos < size - pos) {
+            // The range itself serves as placeholders for the new slots.
+            It it = first;
+            for (size_t i = 0; i < count; ++i, ++it) {
+                PushFront(*it);
+            }
+            for (size_t i = 0; i < pos; ++i) {
+                (*this)[i] = std::move((*this)[i + count]);
+            }
+        } else {
+            Append(first, last);
+            for (size_t i = size; i > pos; --i) {
+                (*this)[i + count - 1] = std::move((*this)[i - 1]);
+            }
+        }
+
+        for (size_t i = pos; first != last; ++i, ++first) {
+            (*this)[i] = *first;
+        }
+    }
+
+    void Erase(size_t pos) {
+        Erase(pos, pos + 1);
+    }
+
+    void Erase(size_t first, size_t last) {
+        if (first >= last) {
+            return;
+        }
+
+        size_t size = Size();
+        size_t count = last - first;
+        if (first < size - last) {
+            for (size_t i = first; i > 0; --i) {
+                (*this)[i + count - 1] = std::move((*this)[i - 1]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                PopFront();
+            }
+        } else {
+            for (size_t i = last; i < size; ++i) {
+                (*this)[i - count] = std::move((*this)[i]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                PopBack();
+            }
+        }
     }
 
     void PopBack() {
@@ -380,10 +772,7 @@ public:
         }
 
         cb_.Back()->PopBack();
-        if (cb_.Back()->Empty()) {
-            delete cb_.Back();
-            cb_.PopBack();
-        }
+        DropEmptyBack();
     }
 
     void PopFront() {
@@ -392,10 +781,7 @@ public:
         }
 
         cb_.Front()->PopFront();
-        if (cb_.Front()->Empty()) {
-            delete cb_.Front();
-            cb_.PopFront();
-        }
+        DropEmptyFront();
     }
 
     void Clear() {
@@ -404,10 +790,11 @@ public:
         }
 
         for (size_t i = 0; i < cb_.Size(); ++i) {
-            delete cb_[i];
+            DeletePage(cb_[i]);
         }
 
         cb_.Clear();
     }
 };
 
+#endif // DEQUE_H
@@ -0,0 +1,535 @@
+#ifndef FLAT_HASH_MAP_H
+#define FLAT_HASH_MAP_H
+
+#include "hash.h"
+#include "memory_resource.h"
+#include "vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLAT_HASH_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//================ Control bytes ================//
+
+// One control byte per slot: kEmpty, kDeleted, or the low 7 bits of the
+// key's hash (H2) for a full slot. Full bytes have the high bit clear.
+using CtrlByte = int8_t;
+
+const static CtrlByte kCtrlEmpty = -128;
+const static CtrlByte kCtrlDeleted = -2;
+
+// Matching slots of a group as a bit mask: one bit per slot with SSE2, the
+// high bit of one byte per slot with SWAR (Shift = 3 turns a bit index into
+// a slot index).
+template <class Mask, int Shift>
+class GroupBits {
+    Mask bits_;
+
+public:
+    explicit GroupBits(Mask bits) : bits_(bits) {
+    }
+
+    explicit operator bool() const {
+        return bits_ != 0;
+    }
+
+    size_t Lowest() const {
+        return static_cast<size_t>(__builtin_ctzll(bits_)) >> Shift;
+    }
+
+    void ClearLowest() {
+        bits_ &= bits_ - 1;
+    }
+};
+
+#ifdef FLAT_HASH_MAP_SSE2
+
+// Sixteen control bytes compared at once.
+class CtrlGroup {
+    __m128i ctrl_;
+
+public:
+    using Bits = GroupBits<uint32_t, 0>;
+    const static size_t kWidth = 16;
+
+    explicit CtrlGroup(const CtrlByte* ctrl) : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {
+    }
+
+    Bits Match(CtrlByte h2) const {
+        return Bits(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_))));
+    }
+
+    Bits MatchEmpty() const {
+        return Bits(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(kCtrlEmpty), ctrl_))));
+    }
+
+    // Empty and deleted are exactly the bytes with the high bit set.
+    Bits MatchEmptyOrDeleted() const {
+        return Bits(static_cast<uint32_t>(_mm_movemask_epi8(ctrl_)));
+    }
+};
+
+#else
+
+// Portable fallback: eight control bytes in a word (little-endian load).
+class CtrlGroup {
+    uint64_t ctrl_;
+
+    const static uint64_t kLsbs = 0x0101010101010101ULL;
+    const static uint64_t kMsbs = 0x8080808080808080ULL;
+
+public:
+    using Bits = GroupBits<uint64_t, 3>;
+    const static size_t kWidth = 8;
+
+    explicit CtrlGroup(const CtrlByte* ctrl) {
+        std::memcpy(&ctrl_, ctrl, sizeof(ctrl_));
+    }
+
+    // May report a false match in the byte after a true one; callers
+    // compare keys anyway.
+    Bits Match(CtrlByte h2) const {
+        uint64_t x = ctrl_ ^ (kLsbs * static_cast<uint8_t>(h2));
+        return Bits((x - kLsbs) & ~x & kMsbs);
+    }
+
+    // High bit set and bit 1 clear: 0x80 only.
+    Bits MatchEmpty() const {
+        return Bits(ctrl_ & ~(ctrl_ << 6) & kMsbs);
+    }
+
+    Bits MatchEmptyOrDeleted() const {
+        return Bits(ctrl_ & ~(ctrl_ << 7) & kMsbs);
+    }
+};
+
+#endif
+
+//================ FlatHashMap ================//
+
+// Open-addressing hash map in the Swiss-table layout: a control byte array
+// and a slot array, both Vectors from one MemoryResource. Lookups probe a
+// group of control bytes at a time (16 with SSE2, 8 otherwise), comparing
+// keys only where the hash's low 7 bits match. The capacity is a power of
+// two; the first group of control bytes is mirrored past the end so that a
+// group can be loaded at any slot without wrapping.
+//
+// Slots are raw storage from the map's resource: a slot is constructed when
+// it is filled and destroyed when its entry is erased, so an empty slot costs
+// only its control byte. Rehashing moves entries (copies them if the move
+// may throw). operator[] needs a default-constructible V. If
+// HashFn and EqualFn are transparent (is_transparent, as for String keys),
+// Find/Contains/Erase accept any type they take, e.g. a StringView.
+// Pointers returned by Find() are invalidated by the next insertion.
+template <class K, class V, class HashFn = Hasher<K>, class EqualFn = KeyEqual<K>>
+class FlatHashMap {
+    struct Slot {
+        K key;
+        V value;
+    };
+
+    const static size_t kWidth = CtrlGroup::kWidth;
+    const static size_t kNotFound = static_cast<size_t>(-1);
+
+    template <class F, class = void>
+    struct IsTransparent : std::false_type {};
+
+    template <class F>
+    struct IsTransparent<F, std::void_t<typename F::is_transparent>> : std::true_type {};
+
+    // Heterogeneous overloads exist only for transparent HashFn and EqualFn.
+    template <class Q>
+    using Lookup = std::enable_if_t<
+            IsTransparent<HashFn>::value && IsTransparent<EqualFn>::value && !std::is_same<Q, K>::value, int>;
+
+    Vector<CtrlByte> ctrl_;
+    Slot* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t deleted_ = 0;
+    float max_load_factor_ = 0.875f;
+    HashFn hash_;
+    EqualFn equal_;
+
+    static size_t H1(size_t hash) {
+        return hash >> 7;
+    }
+
+    static CtrlByte H2(size_t hash) {
+        return static_cast<CtrlByte>(hash & 0x7f);
+    }
+
+    // Slots that may be full or deleted before the table grows; at least one
+    // stays empty so that every probe terminates.
+    size_t MaxFill() const {
+        size_t fill = static_cast<size_t>(static_cast<double>(capacity_) * max_load_factor_);
+        return fill < capacity_ ? fill : capacity_ - 1;
+    }
+
+    void SetCtrl(size_t idx, CtrlByte value) {
+        ctrl_[idx] = value;
+        if (idx < kWidth) {
+            ctrl_[capacity_ + idx] = value;
+        }
+    }
+
+    template <class Q>
+    size_t FindIndex(const Q& key, size_t hash) const {
+        if (capacity_ == 0) {
+            return kNotFound;
+        }
+
+        const size_t mask = capacity_ - 1;
+        const CtrlByte h2 = H2(hash);
+        size_t pos = H1(hash) & mask;
+        for (size_t step = kWidth;; step += kWidth) {
+            CtrlGroup group(&ctrl_[pos]);
+            for (auto bits = group.Match(h2); bits; bits.ClearLowest()) {
+                size_t idx = (pos + bits.Lowest()) & mask;
+                if (equal_(slots_[idx].key, key)) {
+                    return idx;
+                }
+            }
+            if (group.MatchEmpty()) {
+                return kNotFound;
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // First empty or deleted slot on the probe sequence of hash.
+    size_t FindFreeIndex(size_t hash) const {
+        const size_t mask = capacity_ - 1;
+        size_t pos = H1(hash) & mask;
+        for (size_t step = kWidth;; step += kWidth) {
+            auto bits = CtrlGroup(&ctrl_[pos]).MatchEmptyOrDeleted();
+            if (bits) {
+                return (pos + bits.Lowest()) & mask;
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    Slot* AllocateSlots(size_t count) {
+        return static_cast<Slot*>(Resource()->Allocate(count * sizeof(Slot), alignof(Slot)));
+    }
+
+    void FreeSlots(Slot* slots, size_t count) {
+        if (slots != nullptr) {
+            Resource()->Deallocate(slots, count * sizeof(Slot), alignof(Slot));
+        }
+    }
+
+    // Destroys the entries of full slots; control bytes are left as they are.
+    void DestroySlots() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                slots_[i].~Slot();
+            }
+        }
+    }
+
+    // Rebuilds the table with new_capacity slots (a power of two, at least
+    // one group), dropping tombstones. If moving an entry throws, the map is
+    // left as it was.
+    void Rehash(size_t new_capacity) {
+        Vector<CtrlByte> old_ctrl(new_capacity + kWidth, kCtrlEmpty, Resource());
+        Slot* old_slots = AllocateSlots(new_capacity);
+        // Now the old table is in old_ctrl/old_slots.
+        old_ctrl.Swap(ctrl_);
+        ::Swap(old_slots, slots_);
+        size_t old_capacity = capacity_;
+        capacity_ = new_capacity;
+
+        try {
+            for (size_t i = 0; i < old_capacity; ++i) {
+                if (old_ctrl[i] >= 0) {
+                    size_t hash = hash_(old_slots[i].key);
+                    size_t idx = FindFreeIndex(hash);
+                    new (slots_ + idx) Slot{std::move_if_noexcept(old_slots[i].key),
+                                            std::move_if_noexcept(old_slots[i].value)};
+                    SetCtrl(idx, H2(hash));
+                }
+            }
+        } catch (...) {
+            DestroySlots();
+            FreeSlots(slots_, capacity_);
+            old_ctrl.Swap(ctrl_);
+            slots_ = old_slots;
+            capacity_ = old_capacity;
+            throw;
+        }
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] >= 0) {
+                old_slots[i].~Slot();
+            }
+        }
+        FreeSlots(old_slots, old_capacity);
+        deleted_ = 0;
+    }
+
+    static size_t CapacityFor(size_t count, float max_load_factor) {
+        size_t capacity = kWidth;
+        while (static_cast<double>(capacity) * max_load_factor < static_cast<double>(count) + 1) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    // Makes room for one more full slot. A table that is mostly tombstones
+    // is rebuilt at the same capacity instead of doubling.
+    void Grow() {
+        if (capacity_ == 0) {
+            Rehash(kWidth);
+        } else if (size_ * 2 <= MaxFill()) {
+            Rehash(capacity_);
+        } else {
+            Rehash(capacity_ * 2);
+        }
+    }
+
+    // Index of key's slot, inserting (key, V(value_args...)) if it is
+    // missing.
+    template <class KeyArg, class... ValueArgs>
+    std::pair<size_t, bool> FindOrInsert(KeyArg&& key, ValueArgs&&... value_args) {
+        size_t hash = hash_(key);
+        size_t idx = FindIndex(key, hash);
+        if (idx != kNotFound) {
+            return {idx, false};
+        }
+
+        if (capacity_ == 0) {
+            Grow();
+        }
+        idx = FindFreeIndex(hash);
+        if (ctrl_[idx] == kCtrlEmpty && size_ + deleted_ + 1 > MaxFill()) {
+            Grow();
+            idx = FindFreeIndex(hash);
+        }
+
+        new (slots_ + idx) Slot{std::forward<KeyArg>(key), V(std::forward<ValueArgs>(value_args)...)};
+        if (ctrl_[idx] == kCtrlDeleted) {
+            --deleted_;
+        }
+        SetCtrl(idx, H2(hash));
+        ++size_;
+        return {idx, true};
+    }
+
+    void EraseAt(size_t idx) {
+        slots_[idx].~Slot();
+        SetCtrl(idx, kCtrlDeleted);
+        --size_;
+        ++deleted_;
+    }
+
+public:
+    FlatHashMap() : FlatHashMap(DefaultResource()) {
+    }
+
+    explicit FlatHashMap(MemoryResource* resource) : ctrl_(resource) {
+    }
+
+    explicit FlatHashMap(size_t expected_size, MemoryResource* resource = DefaultResource())
+            : FlatHashMap(resource) {
+        Reserve(expected_size);
+    }
+
+    FlatHashMap(const FlatHashMap& other) : FlatHashMap(other, DefaultResource()) {
+    }
+
+    FlatHashMap(const FlatHashMap& other, MemoryResource* resource) : FlatHashMap(resource) {
+        max_load_factor_ = other.max_load_factor_;
+        Reserve(other.size_);
+        other.ForEach([this](const K& key, const V& value) {
+            Insert(key, value);
+        });
+    }
+
+    FlatHashMap& operator=(const FlatHashMap& other) {
+        if (this != &other) {
+            FlatHashMap copy(other, Resource());
+            Swap(copy);
+        }
+        return *this;
+    }
+
+    ~FlatHashMap() {
+        DestroySlots();
+        FreeSlots(slots_, capacity_);
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    MemoryResource* Resource() const {
+        return ctrl_.Resource();
+    }
+
+    float LoadFactor() const {
+        return capacity_ == 0 ? 0.0f : static_cast<float>(size_) / static_cast<float>(capacity_);
+    }
+
+    float MaxLoadFactor() const {
+        return max_load_factor_;
+    }
+
+    // Fraction of slots (full or tombstones) allowed before the table grows;
+    // lower trades memory for shorter probes. Takes effect at the next
+    // insertion.
+    void SetMaxLoadFactor(float max_load_factor) {
+        if (!(max_load_factor > 0.0f && max_load_factor < 1.0f)) {
+            throw std::invalid_argument("FlatHashMap load factor must be in (0, 1)");
+        }
+        max_load_factor_ = max_load_factor;
+    }
+
+    // Room for count entries without rehashing.
+    void Reserve(size_t count) {
+        size_t capacity = CapacityFor(count, max_load_factor_);
+        if (capacity > capacity_) {
+            Rehash(capacity);
+        }
+    }
+
+    void Clear() {
+        if (capacity_ == 0) {
+            return;
+        }
+        DestroySlots();
+        for (size_t i = 0; i < capacity_ + kWidth; ++i) {
+            ctrl_[i] = kCtrlEmpty;
+        }
+        size_ = 0;
+        deleted_ = 0;
+    }
+
+    // False (and no change) if the key is already present.
+    bool Insert(const K& key, const V& value) {
+        return FindOrInsert(key, value).second;
+    }
+
+    bool Insert(K&& key, V&& value) {
+        return FindOrInsert(std::move(key), std::move(value)).second;
+    }
+
+    // Inserts or overwrites.
+    void InsertOrAssign(const K& key, const V& value) {
+        std::pair<size_t, bool> res = FindOrInsert(key, value);
+        if (!res.second) {
+            slots_[res.first].value = value;
+        }
+    }
+
+    // The index is taken first: an insertion may move slots_.
+    V& operator[](const K& key) {
+        size_t idx = FindOrInsert(key).first;
+        return slots_[idx].value;
+    }
+
+    V& operator[](K&& key) {
+        size_t idx = FindOrInsert(std::move(key)).first;
+        return slots_[idx].value;
+    }
+
+    V* Find(const K& key) {
+        size_t idx = FindIndex(key, hash_(key));
+        return idx == kNotFound ? nullptr : &slots_[idx].value;
+    }
+
+    const V* Find(const K& key) const {
+        size_t idx = FindIndex(key, hash_(key));
+        return idx == kNotFound ? nullptr : &slots_[idx].value;
+    }
+
+    template <class Q, Lookup<Q> = 0>
+    V* Find(const Q& key) {
+        size_t idx = FindIndex(key, hash_(key));
+        return idx == kNotFound ? nullptr : &slots_[idx].value;
+    }
+
+    template <class Q, Lookup<Q> = 0>
+    const V* Find(const Q& key) const {
+        size_t idx = FindIndex(key, hash_(key));
+        return idx == kNotFound ? nullptr : &slots_[idx].value;
+    }
+
+    bool Contains(const K& key) const {
+        return Find(key) != nullptr;
+    }
+
+    template <class Q, Lookup<Q> = 0>
+    bool Contains(const Q& key) const {
+        return Find(key) != nullptr;
+    }
+
+    // False if the key was not there.
+    bool Erase(const K& key) {
+        size_t idx = FindIndex(key, hash_(key));
+        if (idx == kNotFound) {
+            return false;
+        }
+        EraseAt(idx);
+        return true;
+    }
+
+    template <class Q, Lookup<Q> = 0>
+    bool Erase(const Q& key) {
+        size_t idx = FindIndex(key, hash_(key));
+        if (idx == kNotFound) {
+            return false;
+        }
+        EraseAt(idx);
+        return true;
+    }
+
+    // Calls visit(const K&, V&) for every entry, in slot order. visit must
+    // not insert into or erase from the map.
+    template <class Visit>
+    void ForEach(Visit visit) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                visit(static_cast<const K&>(slots_[i].key), slots_[i].value);
+            }
+        }
+    }
+
+    template <class Visit>
+    void ForEach(Visit visit) const {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                visit(slots_[i].key, slots_[i].value);
+            }
+        }
+    }
+
+    void Swap(FlatHashMap& other) {
+        ctrl_.Swap(other.ctrl_);
+        ::Swap(slots_, other.slots_);
+        ::Swap(capacity_, other.capacity_);
+        ::Swap(size_, other.size_);
+        ::Swap(deleted_, other.deleted_);
+        ::Swap(max_load_factor_, other.max_load_factor_);
+    }
+};
+
+#endif // FLAT_HASH_MAP_H
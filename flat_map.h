@@ -0,0 +1,228 @@
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include "memory_resource.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+// Sorted map in two columns: keys_ and values_ are Vectors kept in key
+// order, so a lookup touches only the key column and a range scan reads both
+// columns front to back. Lookups use a branchless lower bound (the loop
+// body is a conditional move, not a branch the predictor has to guess).
+//
+// Single inserts and erases shift the tail: O(n). Loading many entries at
+// once should go through InsertBatch, which sorts the batch and merges it in
+// one pass. K and V must be default-constructible and assignable.
+template <class K, class V, class Compare = std::less<K>>
+class FlatMap {
+    Vector<K> keys_;
+    Vector<V> values_;
+    Compare less_;
+
+    // Past this many keys the search prefetches both candidate midpoints of
+    // the next step.
+    const static size_t kPrefetchFrom = 4096;
+
+    bool Equivalent(const K& lhs, const K& rhs) const {
+        return !less_(lhs, rhs) && !less_(rhs, lhs);
+    }
+
+    // Opens a gap at idx.
+    void InsertAt(size_t idx, const K& key, const V& value) {
+        keys_.PushBack(key);
+        values_.PushBack(value);
+        for (size_t i = keys_.Size() - 1; i > idx; --i) {
+            keys_[i] = std::move(keys_[i - 1]);
+            values_[i] = std::move(values_[i - 1]);
+        }
+        keys_[idx] = key;
+        values_[idx] = value;
+    }
+
+public:
+    FlatMap() : FlatMap(DefaultResource()) {
+    }
+
+    explicit FlatMap(MemoryResource* resource) : keys_(resource), values_(resource) {
+    }
+
+    size_t Size() const {
+        return keys_.Size();
+    }
+
+    bool Empty() const {
+        return keys_.Empty();
+    }
+
+    MemoryResource* Resource() const {
+        return keys_.Resource();
+    }
+
+    void Reserve(size_t count) {
+        keys_.Reserve(count);
+        values_.Reserve(count);
+    }
+
+    void Clear() {
+        keys_.Clear();
+        values_.Clear();
+    }
+
+    // Index of the first key not less than key (Size() if there is none).
+    size_t LowerBound(const K& key) const {
+        size_t count = keys_.Size();
+        if (count == 0) {
+            return 0;
+        }
+
+        const K* first = keys_.Data();
+        const K* base = first;
+        while (count > 1) {
+            size_t half = count / 2;
+            if (count >= kPrefetchFrom) {
+                __builtin_prefetch(base + half / 2);
+                __builtin_prefetch(base + half + half / 2);
+            }
+            base = less_(base[half], key) ? base + half : base;
+            count -= half;
+        }
+        return static_cast<size_t>(base - first) + less_(*base, key);
+    }
+
+    // Index of the first key greater than key.
+    size_t UpperBound(const K& key) const {
+        size_t idx = LowerBound(key);
+        return idx < Size() && !less_(key, keys_[idx]) ? idx + 1 : idx;
+    }
+
+    V* Find(const K& key) {
+        size_t idx = LowerBound(key);
+        return idx < Size() && !less_(key, keys_[idx]) ? &values_[idx] : nullptr;
+    }
+
+    const V* Find(const K& key) const {
+        size_t idx = LowerBound(key);
+        return idx < Size() && !less_(key, keys_[idx]) ? &values_[idx] : nullptr;
+    }
+
+    bool Contains(const K& key) const {
+        return Find(key) != nullptr;
+    }
+
+    // False (and no change) if the key is already present.
+    bool Insert(const K& key, const V& value) {
+        size_t idx = LowerBound(key);
+        if (idx < Size() && !less_(key, keys_[idx])) {
+            return false;
+        }
+        InsertAt(idx, key, value);
+        return true;
+    }
+
+    V& operator[](const K& key) {
+        size_t idx = LowerBound(key);
+        if (idx == Size() || less_(key, keys_[idx])) {
+            InsertAt(idx, key, V());
+        }
+        return values_[idx];
+    }
+
+    // Inserts (key, value) pairs from [first, last) with one sort of the
+    // batch and one merge pass: O(n + m log m) instead of m shifts. As with
+    // Insert, keys already in the map keep their values; within the batch
+    // the first occurrence of a key wins.
+    template <class It>
+    void InsertBatch(It first, It last) {
+        Vector<std::pair<K, V>> batch;
+        for (; first != last; ++first) {
+            batch.PushBack(std::pair<K, V>(first->first, first->second));
+        }
+        if (batch.Empty()) {
+            return;
+        }
+
+        std::pair<K, V>* begin = &batch[0];
+        std::pair<K, V>* end = begin + batch.Size();
+        std::stable_sort(begin, end, [this](const std::pair<K, V>& lhs, const std::pair<K, V>& rhs) {
+            return less_(lhs.first, rhs.first);
+        });
+
+        Vector<K> keys(Resource());
+        Vector<V> values(Resource());
+        keys.Reserve(Size() + batch.Size());
+        values.Reserve(Size() + batch.Size());
+
+        size_t idx = 0;
+        for (std::pair<K, V>* it = begin; it != end; ++it) {
+            if (it != begin && Equivalent(it->first, (it - 1)->first)) {
+                continue;
+            }
+            while (idx < Size() && less_(keys_[idx], it->first)) {
+                keys.PushBack(keys_[idx]);
+                values.PushBack(values_[idx]);
+                ++idx;
+            }
+            if (idx < Size() && !less_(it->first, keys_[idx])) {
+                continue;
+            }
+            keys.PushBack(it->first);
+            values.PushBack(it->second);
+        }
+        for (; idx < Size(); ++idx) {
+            keys.PushBack(keys_[idx]);
+            values.PushBack(values_[idx]);
+        }
+
+        keys_.Swap(keys);
+        values_.Swap(values);
+    }
+
+    // False if the key was not there.
+    bool Erase(const K& key) {
+        size_t idx = LowerBound(key);
+        if (idx == Size() || less_(key, keys_[idx])) {
+            return false;
+        }
+        for (size_t i = idx + 1; i < Size(); ++i) {
+            keys_[i - 1] = std::move(keys_[i]);
+            values_[i - 1] = std::move(values_[i]);
+        }
+        keys_.PopBack();
+        values_.PopBack();
+        return true;
+    }
+
+    // Entries by position, in key order.
+    const K& KeyAt(size_t idx) const {
+        return keys_[idx];
+    }
+
+    V& ValueAt(size_t idx) {
+        return values_[idx];
+    }
+
+    const V& ValueAt(size_t idx) const {
+        return values_[idx];
+    }
+
+    // Calls visit(const K&, V&) for every key in [from, to), in order.
+    template <class Visit>
+    void ForEachInRange(const K& from, const K& to, Visit visit) {
+        for (size_t i = LowerBound(from); i < Size() && less_(keys_[i], to); ++i) {
+            visit(keys_[i], values_[i]);
+        }
+    }
+
+    template <class Visit>
+    void ForEach(Visit visit) {
+        for (size_t i = 0; i < Size(); ++i) {
+            visit(static_cast<const K&>(keys_[i]), values_[i]);
+        }
+    }
+};
+
+#endif // FLAT_MAP_H
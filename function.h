@@ -0,0 +1,261 @@
+#ifndef FUNCTION_H
+#define FUNCTION_H
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class BadFunctionCall : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "call of an empty Function";
+    }
+};
+
+// With the default inline size a Function is exactly one cache line.
+const static size_t kFunctionInlineSize = 6 * sizeof(void*);
+
+template <class Signature, size_t InlineSize = kFunctionInlineSize>
+class Function;
+
+// Move-only type-erased callable, built like Any: a per-type static table of
+// move/destroy functions instead of a virtual base, and an inline buffer for
+// small callables. Callables that fit (StoresInline<F>()) are never put on the
+// heap. Being move-only, it can own captures such as UniquePtr.
+template <class R, class... Args, size_t InlineSize>
+class Function<R(Args...), InlineSize> {
+    union Storage {
+        alignas(std::max_align_t) unsigned char buffer[InlineSize];
+        void* heap;
+    };
+
+    struct Operations {
+        void (*move)(Storage& dst, Storage& src) noexcept;
+        void (*destroy)(Storage& storage) noexcept;
+    };
+
+    template <class F>
+    struct InlineHandler {
+        static F* Get(Storage& storage) {
+            return std::launder(reinterpret_cast<F*>(storage.buffer));
+        }
+
+        template <class G>
+        static void Create(Storage& storage, G&& fn) {
+            new (storage.buffer) F(std::forward<G>(fn));
+        }
+
+        static void Move(Storage& dst, Storage& src) noexcept {
+            new (dst.buffer) F(std::move(*Get(src)));
+            Get(src)->~F();
+        }
+
+        static void Destroy(Storage& storage) noexcept {
+            Get(storage)->~F();
+        }
+    };
+
+    template <class F>
+    struct HeapHandler {
+        static F* Get(Storage& storage) {
+            return static_cast<F*>(storage.heap);
+        }
+
+        template <class G>
+        static void Create(Storage& storage, G&& fn) {
+            storage.heap = new F(std::forward<G>(fn));
+        }
+
+        static void Move(Storage& dst, Storage& src) noexcept {
+            dst.heap = src.heap;
+            src.heap = nullptr;
+        }
+
+        static void Destroy(Storage& storage) noexcept {
+            delete Get(storage);
+        }
+    };
+
+    template <class F>
+    static constexpr bool FitsInline() {
+        return sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<F>::value;
+    }
+
+    template <class F>
+    using Handler = typename std::conditional<FitsInline<F>(), InlineHandler<F>, HeapHandler<F>>::type;
+
+    template <class F>
+    static R Invoke(Storage& storage, Args&&... args) {
+        return static_cast<R>((*Handler<F>::Get(storage))(std::forward<Args>(args)...));
+    }
+
+    template <class F>
+    static const Operations* OperationsFor() {
+        static const Operations operations = {
+                &Handler<F>::Move,
+                &Handler<F>::Destroy,
+        };
+        return &operations;
+    }
+
+    template <class F>
+    using EnableIfCallable = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, Function>::value &&
+            std::is_invocable_r<R, typename std::decay<F>::type&, Args...>::value>::type;
+
+    Storage storage_;
+    // The call goes straight through invoke_; the table is only needed for
+    // moves and destruction.
+    R (*invoke_)(Storage&, Args&&...);
+    const Operations* operations_;
+
+    void MoveFrom(Function& other) noexcept {
+        if (other.operations_ != nullptr) {
+            other.operations_->move(storage_, other.storage_);
+            invoke_ = other.invoke_;
+            operations_ = other.operations_;
+            other.invoke_ = nullptr;
+            other.operations_ = nullptr;
+        }
+    }
+
+public:
+    // True when F is guaranteed to be stored without a heap allocation.
+    template <class F>
+    static constexpr bool StoresInline() {
+        return FitsInline<F>();
+    }
+
+    Function() : invoke_(nullptr), operations_(nullptr) {
+    }
+
+    Function(std::nullptr_t) : Function() {
+    }
+
+    template <class F, class = EnableIfCallable<F>>
+    Function(F&& fn) : Function() {
+        using Callable = typename std::decay<F>::type;
+        Handler<Callable>::Create(storage_, std::forward<F>(fn));
+        invoke_ = &Invoke<Callable>;
+        operations_ = OperationsFor<Callable>();
+    }
+
+    Function(const Function&) = delete;
+    Function& operator=(const Function&) = delete;
+
+    Function(Function&& other) noexcept : Function() {
+        MoveFrom(other);
+    }
+
+    Function& operator=(Function&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    Function& operator=(std::nullptr_t) {
+        Reset();
+        return *this;
+    }
+
+    ~Function() {
+        Reset();
+    }
+
+    void Reset() {
+        if (operations_ != nullptr) {
+            operations_->destroy(storage_);
+            invoke_ = nullptr;
+            operations_ = nullptr;
+        }
+    }
+
+    void Swap(Function& other) noexcept {
+        Function tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    explicit operator bool() const noexcept {
+        return invoke_ != nullptr;
+    }
+
+    R operator()(Args... args) {
+        if (invoke_ == nullptr) {
+            throw BadFunctionCall{};
+        }
+        return invoke_(storage_, std::forward<Args>(args)...);
+    }
+};
+
+template <class Signature>
+class FunctionRef;
+
+// Non-owning callable reference: two words, never allocates. The referenced
+// callable must outlive the FunctionRef. Functions and function pointers are
+// stored by value, so `FunctionRef<int(int)> ref(f)` works for a free f.
+template <class R, class... Args>
+class FunctionRef<R(Args...)> {
+    // A function pointer cannot be converted to void*, so it gets its own
+    // member.
+    union Target {
+        void* object;
+        void (*function)();
+    };
+
+    Target target_;
+    R (*invoke_)(Target, Args&&...);
+
+    template <class F>
+    static R InvokeObject(Target target, Args&&... args) {
+        return static_cast<R>((*static_cast<F*>(target.object))(std::forward<Args>(args)...));
+    }
+
+    template <class F>
+    static R InvokeFunction(Target target, Args&&... args) {
+        return static_cast<R>(reinterpret_cast<F>(target.function)(std::forward<Args>(args)...));
+    }
+
+    template <class F>
+    void Bind(F* fn, std::true_type) noexcept {
+        target_.function = reinterpret_cast<void (*)()>(fn);
+        invoke_ = &InvokeFunction<F*>;
+    }
+
+    template <class F>
+    void Bind(F& fn, std::false_type) noexcept {
+        target_.object = const_cast<void*>(static_cast<const void*>(std::addressof(fn)));
+        invoke_ = &InvokeObject<F>;
+    }
+
+    template <class F>
+    using IsFunctionPointer = std::integral_constant<bool,
+            std::is_pointer<typename std::decay<F>::type>::value &&
+            std::is_function<typename std::remove_pointer<typename std::decay<F>::type>::type>::value>;
+
+public:
+    template <class F, class = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, FunctionRef>::value &&
+            std::is_invocable_r<R, F&, Args...>::value>::type>
+    FunctionRef(F&& fn) noexcept {
+        Bind(static_cast<typename std::conditional<IsFunctionPointer<F>::value,
+                                                   typename std::decay<F>::type,
+                                                   typename std::remove_reference<F>::type&>::type>(fn),
+             IsFunctionPointer<F>());
+    }
+
+    FunctionRef(const FunctionRef& other) = default;
+    FunctionRef& operator=(const FunctionRef& other) = default;
+
+    R operator()(Args... args) const {
+        return invoke_(target_, std::forward<Args>(args)...);
+    }
+};
+
+#endif // FUNCTION_H
@@ -0,0 +1,161 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "string.h"
+#include "string_view.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+//================ Hashing primitives ================//
+
+const static uint64_t kHashSeed = 0xa0761d6478bd642fULL;
+const static uint64_t kHashPrime1 = 0xe7037ed1a0b428dbULL;
+const static uint64_t kHashPrime2 = 0x8ebc6af09c88c6e3ULL;
+const static uint64_t kHashPrime3 = 0x589965cc75374cc3ULL;
+
+// 64x64 -> 128 bit multiply, folded: the mixing step of the byte hash and
+// of the integer finalizer.
+inline uint64_t MultiplyFold(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t high_a = a >> 32, low_a = a & 0xffffffff;
+    uint64_t high_b = b >> 32, low_b = b & 0xffffffff;
+    uint64_t low = low_a * low_b;
+    uint64_t middle1 = high_a * low_b;
+    uint64_t middle2 = low_a * high_b;
+    uint64_t high = high_a * high_b;
+    uint64_t carry = ((low >> 32) + (middle1 & 0xffffffff) + (middle2 & 0xffffffff)) >> 32;
+    return (low + (middle1 << 32) + (middle2 << 32)) ^ (high + (middle1 >> 32) + (middle2 >> 32) + carry);
+#endif
+}
+
+inline uint64_t HashInt(uint64_t value) {
+    return MultiplyFold(value ^ kHashSeed, kHashPrime1);
+}
+
+inline uint64_t LoadWord(const unsigned char* ptr) {
+    uint64_t word;
+    std::memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+inline uint64_t LoadHalfWord(const unsigned char* ptr) {
+    uint32_t word;
+    std::memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+// Byte-string hash in the wyhash family. Inputs up to 16 bytes take two
+// (possibly overlapping) loads and no loop; longer ones are consumed 16 bytes
+// per step, and past 48 bytes in three independent lanes so that the
+// multiplies overlap. Not for untrusted keys: there is no per-process seed.
+inline uint64_t HashBytes(const void* data, size_t size) {
+    const unsigned char* ptr = static_cast<const unsigned char*>(data);
+    uint64_t seed = kHashSeed ^ MultiplyFold(kHashSeed ^ kHashPrime1, kHashPrime2);
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    if (size <= 16) {
+        if (size >= 4) {
+            size_t shift = (size >> 3) << 2;
+            a = (LoadHalfWord(ptr) << 32) | LoadHalfWord(ptr + shift);
+            b = (LoadHalfWord(ptr + size - 4) << 32) | LoadHalfWord(ptr + size - 4 - shift);
+        } else if (size > 0) {
+            a = (static_cast<uint64_t>(ptr[0]) << 16) | (static_cast<uint64_t>(ptr[size >> 1]) << 8) | ptr[size - 1];
+        }
+    } else {
+        size_t left = size;
+        if (left > 48) {
+            uint64_t lane1 = seed;
+            uint64_t lane2 = seed;
+            do {
+                seed = MultiplyFold(LoadWord(ptr) ^ kHashPrime1, LoadWord(ptr + 8) ^ seed);
+                lane1 = MultiplyFold(LoadWord(ptr + 16) ^ kHashPrime2, LoadWord(ptr + 24) ^ lane1);
+                lane2 = MultiplyFold(LoadWord(ptr + 32) ^ kHashPrime3, LoadWord(ptr + 40) ^ lane2);
+                ptr += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (left > 16) {
+            seed = MultiplyFold(LoadWord(ptr) ^ kHashPrime1, LoadWord(ptr + 8) ^ seed);
+            ptr += 16;
+            left -= 16;
+        }
+        a = LoadWord(ptr + left - 16);
+        b = LoadWord(ptr + left - 8);
+    }
+
+    return MultiplyFold(kHashPrime1 ^ size, MultiplyFold(a ^ kHashPrime1, b ^ seed));
+}
+
+//================ Hasher / KeyEqual ================//
+
+// Default hash functor of FlatHashMap. Integers, enums and pointers are
+// mixed directly; other types go through std::hash and are mixed afterwards,
+// since std::hash of an integer is often the identity.
+template <class T, class = void>
+struct Hasher {
+    size_t operator()(const T& value) const {
+        return HashInt(std::hash<T>()(value));
+    }
+};
+
+template <class T>
+struct Hasher<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value>> {
+    size_t operator()(T value) const {
+        return HashInt(static_cast<uint64_t>(value));
+    }
+};
+
+template <class T>
+struct Hasher<T*> {
+    size_t operator()(const T* value) const {
+        return HashInt(reinterpret_cast<uintptr_t>(value));
+    }
+};
+
+// Strings and views hash alike, so a String-keyed map can be searched with
+// a StringView or a literal (is_transparent).
+struct StringHasher {
+    using is_transparent = void;
+
+    size_t operator()(StringView str) const {
+        return HashBytes(str.Data(), str.Size());
+    }
+};
+
+template <>
+struct Hasher<String> : StringHasher {};
+
+template <>
+struct Hasher<StringView> : StringHasher {};
+
+template <class T>
+struct KeyEqual {
+    bool operator()(const T& lhs, const T& rhs) const {
+        return lhs == rhs;
+    }
+};
+
+struct StringEqual {
+    using is_transparent = void;
+
+    bool operator()(StringView lhs, StringView rhs) const {
+        return lhs == rhs;
+    }
+};
+
+template <>
+struct KeyEqual<String> : StringEqual {};
+
+template <>
+struct KeyEqual<StringView> : StringEqual {};
+
+#endif // HASH_H
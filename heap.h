@@ -0,0 +1,347 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "memory_resource.h"
+#include "vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+// Index arithmetic of an implicit D-ary heap stored from index 0.
+template <size_t D>
+struct DaryLayout {
+    static_assert(D >= 2, "heap arity must be at least 2");
+
+    static size_t Parent(size_t idx) {
+        return (idx - 1) / D;
+    }
+
+    static size_t FirstChild(size_t idx) {
+        return idx * D + 1;
+    }
+};
+
+//================ DaryHeap ================//
+
+// Priority queue over a Vector with D children per node. Top() is the
+// greatest element under Compare, as in std::priority_queue. A wider node
+// makes the tree log2(D) times shallower: sift-down compares D siblings
+// that sit next to each other (one cache line for D * sizeof(T) <= 64)
+// instead of visiting a new line per level, and sift-up takes fewer steps.
+// Both sifts move a hole instead of swapping.
+template <class T, size_t D = 4, class Compare = std::less<T>>
+class DaryHeap {
+    using Layout = DaryLayout<D>;
+
+    Vector<T> data_;
+    Compare less_;
+
+    void SiftUp(size_t idx) {
+        T value = std::move(data_[idx]);
+        while (idx > 0) {
+            size_t parent = Layout::Parent(idx);
+            if (!less_(data_[parent], value)) {
+                break;
+            }
+            data_[idx] = std::move(data_[parent]);
+            idx = parent;
+        }
+        data_[idx] = std::move(value);
+    }
+
+    // Fills the hole at idx with value.
+    void SiftDown(size_t idx, T&& value) {
+        size_t size = data_.Size();
+        while (true) {
+            size_t first = Layout::FirstChild(idx);
+            if (first >= size) {
+                break;
+            }
+            size_t last = size - first < D ? size : first + D;
+            size_t best = first;
+            for (size_t child = first + 1; child < last; ++child) {
+                best = less_(data_[best], data_[child]) ? child : best;
+            }
+            if (!less_(value, data_[best])) {
+                break;
+            }
+            data_[idx] = std::move(data_[best]);
+            idx = best;
+        }
+        data_[idx] = std::move(value);
+    }
+
+public:
+    DaryHeap() : DaryHeap(DefaultResource()) {
+    }
+
+    explicit DaryHeap(MemoryResource* resource) : data_(resource) {
+    }
+
+    size_t Size() const {
+        return data_.Size();
+    }
+
+    bool Empty() const {
+        return data_.Empty();
+    }
+
+    MemoryResource* Resource() const {
+        return data_.Resource();
+    }
+
+    void Reserve(size_t count) {
+        data_.Reserve(count);
+    }
+
+    void Clear() {
+        data_.Clear();
+    }
+
+    const T& Top() const {
+        return data_.Front();
+    }
+
+    void Push(const T& value) {
+        data_.PushBack(value);
+        SiftUp(data_.Size() - 1);
+    }
+
+    void Pop() {
+        T last = std::move(data_.Back());
+        data_.PopBack();
+        if (!data_.Empty()) {
+            SiftDown(0, std::move(last));
+        }
+    }
+
+    // Adds [first, last) and restores the heap bottom-up (Floyd): O(n) for
+    // the whole heap instead of O(m log n) for m Push() calls.
+    template <class It>
+    void Heapify(It first, It last) {
+        for (; first != last; ++first) {
+            data_.PushBack(*first);
+        }
+        if (data_.Size() < 2) {
+            return;
+        }
+        for (size_t idx = Layout::Parent(data_.Size() - 1) + 1; idx > 0; --idx) {
+            T value = std::move(data_[idx - 1]);
+            SiftDown(idx - 1, std::move(value));
+        }
+    }
+};
+
+//================ IndexedHeap ================//
+
+// Position of a handle whose element has left the heap.
+const static size_t kNotInHeap = SIZE_MAX;
+
+// D-ary heap whose Push() returns a handle. A handle stays valid, wherever
+// its element moves, until that element is popped or erased; after that
+// its number may be reused by a later Push(). Through a handle one can read
+// the element, Update() it in either direction, DecreaseKey() it (move it
+// towards the top) or Erase() it, each in O(log n).
+//
+// The heap array holds (value, handle) pairs so that sifting compares
+// neighbouring values without an indirection; a second Vector maps each
+// handle to its current position.
+template <class T, size_t D = 4, class Compare = std::less<T>>
+class IndexedHeap {
+public:
+    using Handle = uint32_t;
+
+private:
+    using Layout = DaryLayout<D>;
+
+    struct Node {
+        T value;
+        Handle handle;
+    };
+
+    Vector<Node> heap_;
+    Vector<size_t> positions_;
+    Vector<Handle> free_handles_;
+    Compare less_;
+
+    void Place(size_t idx, Node&& node) {
+        positions_[node.handle] = idx;
+        heap_[idx] = std::move(node);
+    }
+
+    void SiftUp(size_t idx) {
+        Node node = std::move(heap_[idx]);
+        while (idx > 0) {
+            size_t parent = Layout::Parent(idx);
+            if (!less_(heap_[parent].value, node.value)) {
+                break;
+            }
+            Place(idx, std::move(heap_[parent]));
+            idx = parent;
+        }
+        Place(idx, std::move(node));
+    }
+
+    void SiftDown(size_t idx) {
+        Node node = std::move(heap_[idx]);
+        size_t size = heap_.Size();
+        while (true) {
+            size_t first = Layout::FirstChild(idx);
+            if (first >= size) {
+                break;
+            }
+            size_t last = size - first < D ? size : first + D;
+            size_t best = first;
+            for (size_t child = first + 1; child < last; ++child) {
+                best = less_(heap_[best].value, heap_[child].value) ? child : best;
+            }
+            if (!less_(node.value, heap_[best].value)) {
+                break;
+            }
+            Place(idx, std::move(heap_[best]));
+            idx = best;
+        }
+        Place(idx, std::move(node));
+    }
+
+    Handle NewHandle() {
+        if (!free_handles_.Empty()) {
+            Handle handle = free_handles_.Back();
+            free_handles_.PopBack();
+            return handle;
+        }
+        positions_.PushBack(kNotInHeap);
+        return static_cast<Handle>(positions_.Size() - 1);
+    }
+
+    // Takes the node at idx out of the heap, filling the gap with the last
+    // node.
+    void RemoveAt(size_t idx) {
+        Handle handle = heap_[idx].handle;
+        positions_[handle] = kNotInHeap;
+        free_handles_.PushBack(handle);
+
+        size_t last = heap_.Size() - 1;
+        if (idx != last) {
+            Place(idx, std::move(heap_[last]));
+        }
+        heap_.PopBack();
+        if (idx == heap_.Size()) {
+            return;
+        }
+        if (idx > 0 && less_(heap_[Layout::Parent(idx)].value, heap_[idx].value)) {
+            SiftUp(idx);
+        } else {
+            SiftDown(idx);
+        }
+    }
+
+public:
+    IndexedHeap() : IndexedHeap(DefaultResource()) {
+    }
+
+    explicit IndexedHeap(MemoryResource* resource)
+            : heap_(resource), positions_(resource), free_handles_(resource) {
+    }
+
+    size_t Size() const {
+        return heap_.Size();
+    }
+
+    bool Empty() const {
+        return heap_.Empty();
+    }
+
+    MemoryResource* Resource() const {
+        return heap_.Resource();
+    }
+
+    void Reserve(size_t count) {
+        heap_.Reserve(count);
+        positions_.Reserve(count);
+    }
+
+    // Drops every element; all handles become invalid and numbering starts
+    // over.
+    void Clear() {
+        heap_.Clear();
+        positions_.Clear();
+        free_handles_.Clear();
+    }
+
+    const T& Top() const {
+        return heap_.Front().value;
+    }
+
+    Handle TopHandle() const {
+        return heap_.Front().handle;
+    }
+
+    Handle Push(const T& value) {
+        Handle handle = NewHandle();
+        heap_.PushBack(Node{value, handle});
+        positions_[handle] = heap_.Size() - 1;
+        SiftUp(heap_.Size() - 1);
+        return handle;
+    }
+
+    void Pop() {
+        RemoveAt(0);
+    }
+
+    // True while the element of handle is in the heap.
+    bool Contains(Handle handle) const {
+        return handle < positions_.Size() && positions_[handle] != kNotInHeap;
+    }
+
+    const T& Get(Handle handle) const {
+        return heap_[positions_[handle]].value;
+    }
+
+    // Replaces the element; it may move either way.
+    void Update(Handle handle, const T& value) {
+        size_t idx = positions_[handle];
+        bool up = less_(heap_[idx].value, value);
+        heap_[idx].value = value;
+        if (up) {
+            SiftUp(idx);
+        } else {
+            SiftDown(idx);
+        }
+    }
+
+    // Replaces the element with one that is not further from the top (for a
+    // min-heap with std::greater: not larger), so only a sift-up is needed.
+    void DecreaseKey(Handle handle, const T& value) {
+        size_t idx = positions_[handle];
+        heap_[idx].value = value;
+        SiftUp(idx);
+    }
+
+    void Erase(Handle handle) {
+        RemoveAt(positions_[handle]);
+    }
+
+    // Adds [first, last) and restores the heap bottom-up in O(n), writing the
+    // new handles, in input order, to out. Returns the advanced out.
+    template <class It, class Out>
+    Out Heapify(It first, It last, Out out) {
+        for (; first != last; ++first) {
+            Handle handle = NewHandle();
+            heap_.PushBack(Node{*first, handle});
+            positions_[handle] = heap_.Size() - 1;
+            *out++ = handle;
+        }
+        if (heap_.Size() < 2) {
+            return out;
+        }
+        for (size_t idx = Layout::Parent(heap_.Size() - 1) + 1; idx > 0; --idx) {
+            SiftDown(idx - 1);
+        }
+        return out;
+    }
+};
+
+#endif // HEAP_H
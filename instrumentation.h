@@ -0,0 +1,303 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+// Allocation counters per container kind, for finding the missing Reserve()
+// calls. Compiled in only with -DCONTAINERS_INSTRUMENTATION; otherwise the
+// CONTAINERS_RECORD_* hooks expand to nothing and Snapshot() reports zeros.
+// The hooks sit in inline and template code (Vector, Deque, Any, SharedPtr),
+// so the whole program must be built with one setting: translation units
+// that differ would define the same inline functions differently, and the
+// linker keeps one of them without a word. The CMake option passes the
+// define on to everything that links the containers library.
+//
+// Every thread counts into its own block (relaxed loads and stores, no RMW);
+// Snapshot() and the dumps sum the blocks of live threads plus whatever
+// exited threads left behind.
+class Instrumentation {
+public:
+    enum Site {
+        kVector,
+        kString,
+        kDequePage,
+        kCircularBuffer,
+        kAny,
+        kSharedPtr,
+        kSites,
+    };
+
+    struct Counters {
+        uint64_t allocations = 0;
+        uint64_t bytes_allocated = 0;
+        uint64_t deallocations = 0;
+        uint64_t bytes_freed = 0;
+        // Buffers replaced by a bigger (or smaller) one, and the bytes of
+        // live elements moved over.
+        uint64_t reallocations = 0;
+        uint64_t bytes_copied = 0;
+        // Largest buffer seen at a reallocation, and the largest size one
+        // container reached, recorded as elements are added.
+        uint64_t peak_capacity = 0;
+        uint64_t peak_size = 0;
+    };
+
+private:
+    enum Field {
+        kAllocations,
+        kBytesAllocated,
+        kDeallocations,
+        kBytesFreed,
+        kReallocations,
+        kBytesCopied,
+        kPeakCapacity,
+        kPeakSize,
+        kFields,
+    };
+
+    struct ThreadCounters {
+        std::atomic<uint64_t> values[kSites][kFields];
+        ThreadCounters* next;
+        ThreadCounters* prev;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        ThreadCounters* head = nullptr;
+        uint64_t retired[kSites][kFields] = {};
+    };
+
+    struct ThreadRegistration {
+        ThreadCounters counters;
+
+        ThreadRegistration() {
+            Clear(counters);
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            counters.prev = nullptr;
+            counters.next = registry.head;
+            if (registry.head != nullptr) {
+                registry.head->prev = &counters;
+            }
+            registry.head = &counters;
+            Local() = &counters;
+        }
+
+        ~ThreadRegistration() {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            Fold(counters, registry.retired);
+            if (counters.prev != nullptr) {
+                counters.prev->next = counters.next;
+            } else {
+                registry.head = counters.next;
+            }
+            if (counters.next != nullptr) {
+                counters.next->prev = counters.prev;
+            }
+            Local() = nullptr;
+            Exited() = true;
+        }
+    };
+
+    // Never destroyed: threads may record during static destruction.
+    static Registry& GetRegistry() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    static ThreadCounters*& Local() {
+        static thread_local ThreadCounters* counters = nullptr;
+        return counters;
+    }
+
+    static bool& Exited() {
+        static thread_local bool exited = false;
+        return exited;
+    }
+
+    static void Clear(ThreadCounters& counters) {
+        for (size_t site = 0; site < kSites; ++site) {
+            for (size_t field = 0; field < kFields; ++field) {
+                counters.values[site][field].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static bool IsPeak(size_t field) {
+        return field == kPeakCapacity || field == kPeakSize;
+    }
+
+    static void Merge(uint64_t& total, size_t field, uint64_t value) {
+        if (IsPeak(field)) {
+            total = total > value ? total : value;
+        } else {
+            total += value;
+        }
+    }
+
+    static void Fold(const ThreadCounters& counters, uint64_t (&totals)[kSites][kFields]) {
+        for (size_t site = 0; site < kSites; ++site) {
+            for (size_t field = 0; field < kFields; ++field) {
+                Merge(totals[site][field], field, counters.values[site][field].load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    static void Update(Site site, Field field, uint64_t value) {
+        ThreadCounters* counters = Local();
+        if (counters == nullptr) {
+            if (Exited()) {
+                Registry& registry = GetRegistry();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                Merge(registry.retired[site][field], field, value);
+                return;
+            }
+            static thread_local ThreadRegistration registration;
+            counters = &registration.counters;
+        }
+
+        std::atomic<uint64_t>& slot = counters->values[site][field];
+        uint64_t current = slot.load(std::memory_order_relaxed);
+        Merge(current, field, value);
+        slot.store(current, std::memory_order_relaxed);
+    }
+
+    static void WriteCounters(std::ostream& os, const Counters& counters, const char* separator,
+                              const char* quote) {
+        os << quote << "allocations" << quote << separator << counters.allocations << ", "
+           << quote << "bytes_allocated" << quote << separator << counters.bytes_allocated << ", "
+           << quote << "deallocations" << quote << separator << counters.deallocations << ", "
+           << quote << "bytes_freed" << quote << separator << counters.bytes_freed << ", "
+           << quote << "reallocations" << quote << separator << counters.reallocations << ", "
+           << quote << "bytes_copied" << quote << separator << counters.bytes_copied << ", "
+           << quote << "peak_capacity" << quote << separator << counters.peak_capacity << ", "
+           << quote << "peak_size" << quote << separator << counters.peak_size;
+    }
+
+public:
+    static constexpr bool Enabled() {
+#ifdef CONTAINERS_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static const char* SiteName(Site site) {
+        static const char* const kNames[kSites] = {
+                "vector", "string", "deque_page", "circular_buffer", "any", "shared_ptr",
+        };
+        return kNames[site];
+    }
+
+    static void RecordAllocation(Site site, size_t bytes) {
+        Update(site, kAllocations, 1);
+        Update(site, kBytesAllocated, bytes);
+    }
+
+    static void RecordDeallocation(Site site, size_t bytes) {
+        Update(site, kDeallocations, 1);
+        Update(site, kBytesFreed, bytes);
+    }
+
+    // A buffer was replaced: copied bytes of elements moved over, the new
+    // buffer holds capacity bytes.
+    static void RecordReallocation(Site site, size_t copied, size_t capacity) {
+        Update(site, kReallocations, 1);
+        Update(site, kBytesCopied, copied);
+        Update(site, kPeakCapacity, capacity);
+    }
+
+    // A container grew to size bytes of live elements.
+    static void RecordSize(Site site, size_t size) {
+        Update(site, kPeakSize, size);
+    }
+
+    static Counters Snapshot(Site site) {
+        uint64_t totals[kSites][kFields];
+        Registry& registry = GetRegistry();
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (size_t s = 0; s < kSites; ++s) {
+                for (size_t field = 0; field < kFields; ++field) {
+                    totals[s][field] = registry.retired[s][field];
+                }
+            }
+            for (ThreadCounters* counters = registry.head; counters != nullptr; counters = counters->next) {
+                Fold(*counters, totals);
+            }
+        }
+
+        Counters res;
+        res.allocations = totals[site][kAllocations];
+        res.bytes_allocated = totals[site][kBytesAllocated];
+        res.deallocations = totals[site][kDeallocations];
+        res.bytes_freed = totals[site][kBytesFreed];
+        res.reallocations = totals[site][kReallocations];
+        res.bytes_copied = totals[site][kBytesCopied];
+        res.peak_capacity = totals[site][kPeakCapacity];
+        res.peak_size = totals[site][kPeakSize];
+        return res;
+    }
+
+    // Counts of threads that update concurrently may survive the reset.
+    static void Reset() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (size_t site = 0; site < kSites; ++site) {
+            for (size_t field = 0; field < kFields; ++field) {
+                registry.retired[site][field] = 0;
+            }
+        }
+        for (ThreadCounters* counters = registry.head; counters != nullptr; counters = counters->next) {
+            Clear(*counters);
+        }
+    }
+
+    // One line per site: "vector allocations=12, bytes_allocated=4096, ...".
+    static void DumpText(std::ostream& os) {
+        if (!Enabled()) {
+            os << "instrumentation disabled (build with -DCONTAINERS_INSTRUMENTATION)\n";
+            return;
+        }
+        for (size_t site = 0; site < kSites; ++site) {
+            os << SiteName(static_cast<Site>(site)) << ' ';
+            WriteCounters(os, Snapshot(static_cast<Site>(site)), "=", "");
+            os << '\n';
+        }
+    }
+
+    // {"enabled": true, "sites": {"vector": {"allocations": 12, ...}, ...}}
+    static void DumpJson(std::ostream& os) {
+        os << "{\"enabled\": " << (Enabled() ? "true" : "false") << ", \"sites\": {";
+        for (size_t site = 0; site < kSites; ++site) {
+            os << (site == 0 ? "" : ", ") << '"' << SiteName(static_cast<Site>(site)) << "\": {";
+            WriteCounters(os, Snapshot(static_cast<Site>(site)), ": ", "\"");
+            os << '}';
+        }
+        os << "}}\n";
+    }
+};
+
+#ifdef CONTAINERS_INSTRUMENTATION
+#define CONTAINERS_RECORD_ALLOCATION(site, bytes) \
+    Instrumentation::RecordAllocation(Instrumentation::site, (bytes))
+#define CONTAINERS_RECORD_DEALLOCATION(site, bytes) \
+    Instrumentation::RecordDeallocation(Instrumentation::site, (bytes))
+#define CONTAINERS_RECORD_REALLOCATION(site, copied, capacity) \
+    Instrumentation::RecordReallocation(Instrumentation::site, (copied), (capacity))
+#define CONTAINERS_RECORD_SIZE(site, size) \
+    Instrumentation::RecordSize(Instrumentation::site, (size))
+#else
+#define CONTAINERS_RECORD_ALLOCATION(site, bytes) ((void)0)
+#define CONTAINERS_RECORD_DEALLOCATION(site, bytes) ((void)0)
+#define CONTAINERS_RECORD_REALLOCATION(site, copied, capacity) ((void)0)
+#define CONTAINERS_RECORD_SIZE(site, size) ((void)0)
+#endif
+
+#endif // INSTRUMENTATION_H
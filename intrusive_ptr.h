@@ -0,0 +1,322 @@
+#ifndef INTRUSIVE_PTR_H
+#define INTRUSIVE_PTR_H
+
+#include "shared_and_weak_ptr.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// CRTP base that keeps the reference count inside the object, so an
+// IntrusivePtr is a single word and needs no control block. Policy is
+// AtomicRefCount or NonAtomicRefCount, as for SharedPtr. Since the count
+// travels with the object, IntrusivePtr<T>(this) is always safe and cheap.
+template<class Derived, class Policy = AtomicRefCount>
+class RefCounted {
+    mutable typename Policy::Count count_;
+
+public:
+    RefCounted() : count_(0) {
+    }
+
+    // Copies of the object start with their own, empty count.
+    RefCounted(const RefCounted&) : count_(0) {
+    }
+
+    RefCounted& operator=(const RefCounted&) {
+        return *this;
+    }
+
+    void AddRef() const {
+        Policy::Increment(count_);
+    }
+
+    void Release() const {
+        if (Policy::Decrement(count_) == 0) {
+            delete static_cast<const Derived*>(this);
+        }
+    }
+
+    size_t UseCount() const {
+        return Policy::Load(count_);
+    }
+
+protected:
+    ~RefCounted() = default;
+};
+
+template<class T>
+class IntrusiveWeakPtr;
+
+// RefCounted plus support for IntrusiveWeakPtr. Weak pointers share a small
+// side block that is allocated on first use, so objects that are never weakly
+// referenced pay only one extra word. Lock() and the final Release() meet on
+// the side block's spinlock, which keeps the object alive while Lock() checks
+// its count; the strong-count fast paths never touch it.
+template<class Derived, class Policy = AtomicRefCount>
+class WeakRefCounted {
+    struct WeakReference {
+        typename Policy::Count refs;
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+        bool alive = true;
+
+        WeakReference() : refs(1) {
+        }
+
+        void Lock() {
+            while (busy.test_and_set(std::memory_order_acquire)) {
+            }
+        }
+
+        void Unlock() {
+            busy.clear(std::memory_order_release);
+        }
+
+        void AddRef() {
+            Policy::Increment(refs);
+        }
+
+        void Release() {
+            if (Policy::Decrement(refs) == 0) {
+                delete this;
+            }
+        }
+    };
+
+    mutable typename Policy::Count count_;
+    mutable std::atomic<WeakReference*> weak_;
+
+    bool TryAddRef() const {
+        return Policy::IncrementIfNotZero(count_);
+    }
+
+    // Only called by a thread that holds a strong reference.
+    WeakReference* GetWeakReference() const {
+        WeakReference* weak = weak_.load(std::memory_order_acquire);
+        if (weak != nullptr) {
+            return weak;
+        }
+
+        WeakReference* created = new WeakReference;
+        if (weak_.compare_exchange_strong(weak, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return created;
+        }
+
+        delete created;
+        return weak;
+    }
+
+    template<class T>
+    friend class IntrusiveWeakPtr;
+
+public:
+    WeakRefCounted() : count_(0), weak_(nullptr) {
+    }
+
+    WeakRefCounted(const WeakRefCounted&) : count_(0), weak_(nullptr) {
+    }
+
+    WeakRefCounted& operator=(const WeakRefCounted&) {
+        return *this;
+    }
+
+    void AddRef() const {
+        Policy::Increment(count_);
+    }
+
+    void Release() const {
+        if (Policy::Decrement(count_) != 0) {
+            return;
+        }
+
+        WeakReference* weak = weak_.load(std::memory_order_acquire);
+        if (weak != nullptr) {
+            weak->Lock();
+            weak->alive = false;
+            weak->Unlock();
+            weak->Release();
+        }
+
+        delete static_cast<const Derived*>(this);
+    }
+
+    size_t UseCount() const {
+        return Policy::Load(count_);
+    }
+
+protected:
+    ~WeakRefCounted() = default;
+};
+
+// Single-word owning pointer to an object derived from RefCounted or
+// WeakRefCounted. Same interface as SharedPtr.
+template<class T>
+class IntrusivePtr {
+    T* ptr_ = nullptr;
+
+    template<class U>
+    friend class IntrusivePtr;
+
+    template<class U>
+    friend class IntrusiveWeakPtr;
+
+    struct AdoptTag {
+    };
+
+    // Takes over a reference that has already been counted.
+    IntrusivePtr(T* ptr, AdoptTag) : ptr_(ptr) {
+    }
+
+public:
+    IntrusivePtr() = default;
+
+    IntrusivePtr(T* ptr) : ptr_(ptr) {
+        if (ptr_ != nullptr) {
+            ptr_->AddRef();
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.ptr_) {
+    }
+
+    template<class U>
+    IntrusivePtr(const IntrusivePtr<U>& other) : IntrusivePtr(other.Get()) {
+    }
+
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    template<class U>
+    IntrusivePtr(IntrusivePtr<U>&& other) noexcept : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    IntrusivePtr& operator=(const IntrusivePtr& other) {
+        IntrusivePtr tmp(other);
+        Swap(tmp);
+        return *this;
+    }
+
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+        IntrusivePtr tmp(std::move(other));
+        Swap(tmp);
+        return *this;
+    }
+
+    ~IntrusivePtr() {
+        if (ptr_ != nullptr) {
+            ptr_->Release();
+        }
+    }
+
+    size_t UseCount() const {
+        return ptr_ ? ptr_->UseCount() : 0;
+    }
+
+    T* Get() const {
+        return ptr_;
+    }
+
+    T& operator*() const {
+        return *ptr_;
+    }
+
+    T* operator->() const {
+        return ptr_;
+    }
+
+    explicit operator bool() const noexcept {
+        return ptr_ != nullptr;
+    }
+
+    void Swap(IntrusivePtr& other) noexcept {
+        std::swap(ptr_, other.ptr_);
+    }
+
+    void Reset(T* ptr = nullptr) {
+        IntrusivePtr tmp(ptr);
+        Swap(tmp);
+    }
+};
+
+// Weak reference to a WeakRefCounted object.
+template<class T>
+class IntrusiveWeakPtr {
+    using WeakReference = typename T::WeakReference;
+
+    T* ptr_ = nullptr;
+    WeakReference* weak_ = nullptr;
+
+public:
+    IntrusiveWeakPtr() = default;
+
+    IntrusiveWeakPtr(const IntrusivePtr<T>& shared) : ptr_(shared.Get()) {
+        if (ptr_ != nullptr) {
+            weak_ = ptr_->GetWeakReference();
+            weak_->AddRef();
+        }
+    }
+
+    IntrusiveWeakPtr(const IntrusiveWeakPtr& other) : ptr_(other.ptr_), weak_(other.weak_) {
+        if (weak_ != nullptr) {
+            weak_->AddRef();
+        }
+    }
+
+    IntrusiveWeakPtr(IntrusiveWeakPtr&& other) noexcept : ptr_(other.ptr_), weak_(other.weak_) {
+        other.ptr_ = nullptr;
+        other.weak_ = nullptr;
+    }
+
+    IntrusiveWeakPtr& operator=(const IntrusiveWeakPtr& other) {
+        IntrusiveWeakPtr tmp(other);
+        Swap(tmp);
+        return *this;
+    }
+
+    IntrusiveWeakPtr& operator=(IntrusiveWeakPtr&& other) noexcept {
+        IntrusiveWeakPtr tmp(std::move(other));
+        Swap(tmp);
+        return *this;
+    }
+
+    ~IntrusiveWeakPtr() {
+        if (weak_ != nullptr) {
+            weak_->Release();
+        }
+    }
+
+    void Swap(IntrusiveWeakPtr& other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        std::swap(weak_, other.weak_);
+    }
+
+    void Reset() {
+        IntrusiveWeakPtr tmp;
+        Swap(tmp);
+    }
+
+    bool Expired() const {
+        return !Lock();
+    }
+
+    IntrusivePtr<T> Lock() const {
+        if (weak_ == nullptr) {
+            return IntrusivePtr<T>();
+        }
+
+        weak_->Lock();
+        bool locked = weak_->alive && ptr_->TryAddRef();
+        weak_->Unlock();
+
+        return locked ? IntrusivePtr<T>(ptr_, typename IntrusivePtr<T>::AdoptTag()) : IntrusivePtr<T>();
+    }
+};
+
+template<class T, class... Args>
+IntrusivePtr<T> MakeIntrusive(Args&&... args) {
+    return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+#endif // INTRUSIVE_PTR_H
@@ -0,0 +1,356 @@
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include "deque.h"
+#include "flat_hash_map.h"
+#include "hash.h"
+#include "shared_and_weak_ptr.h"
+#include "unique_ptr.h"
+#include "vector.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+
+struct LruCacheOptions {
+    // Limits for the whole cache, split evenly between the shards. Zero
+    // bytes means no byte limit.
+    size_t max_entries = 1 << 16;
+    size_t max_bytes = 0;
+    // Rounded up to a power of two.
+    size_t shards = 16;
+};
+
+struct LruCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+// Bytes an entry is charged against max_bytes; specialize, or pass another
+// functor to LruCache, for values that own memory.
+template <class V>
+struct CacheValueBytes {
+    size_t operator()(const V&) const {
+        return sizeof(V);
+    }
+};
+
+// Thread-safe cache with approximate LRU eviction (CLOCK). Keys are spread
+// over shards by hash; each shard has its own reader-writer lock, and a hit
+// takes it shared: it only copies the SharedPtr and sets the entry's
+// reference bit, without relinking anything. Values are handed out as
+// SharedPtr<V>, so an entry that is evicted or replaced stays alive for
+// readers still holding it.
+//
+// A shard keeps its entries in a Deque in insertion order and an index from
+// key to position. The clock hand is the front of the Deque: a referenced
+// entry there gets its bit cleared and moves to the back (a second chance),
+// an unreferenced one is evicted. Erased entries leave a hole that the hand
+// drops when it gets there.
+template <class K, class V, class HashFn = Hasher<K>, class EqualFn = KeyEqual<K>,
+          class SizeFn = CacheValueBytes<V>>
+class LruCache {
+    const static size_t kCacheLine = 64;
+
+    struct Entry {
+        K key;
+        SharedPtr<V> value;
+        size_t bytes = 0;
+        bool live = false;
+        mutable std::atomic<bool> referenced;
+
+        Entry(const K& key, SharedPtr<V> value, size_t bytes)
+                : key(key), value(std::move(value)), bytes(bytes), live(true), referenced(false) {
+        }
+
+        Entry(Entry&& other) noexcept
+                : key(std::move(other.key)),
+                  value(std::move(other.value)),
+                  bytes(other.bytes),
+                  live(other.live),
+                  referenced(other.referenced.load(std::memory_order_relaxed)) {
+        }
+
+        Entry& operator=(Entry&& other) noexcept {
+            key = std::move(other.key);
+            value = std::move(other.value);
+            bytes = other.bytes;
+            live = other.live;
+            referenced.store(other.referenced.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    // Entries are numbered in push order; the one with number n sits at
+    // ring[n - head] and the index stores n.
+    struct alignas(kCacheLine) Shard {
+        std::shared_mutex mutex;
+        FlatHashMap<K, uint64_t, HashFn, EqualFn> index;
+        Deque<Entry> ring;
+        uint64_t head = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> insertions{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+    UniquePtr<Shard[]> shards_;
+    size_t shard_mask_;
+    size_t max_entries_;  // per shard
+    size_t max_bytes_;    // per shard, 0 for none
+    HashFn hash_;
+    SizeFn size_of_;
+
+    Shard& ShardFor(const K& key) const {
+        // The index inside the shard hashes the key again and uses the low
+        // bits, so take the shard from the high ones.
+        return shards_[(static_cast<uint64_t>(hash_(key)) >> 40) & shard_mask_];
+    }
+
+    static Entry& At(Shard& shard, uint64_t number) {
+        return shard.ring[static_cast<size_t>(number - shard.head)];
+    }
+
+    // The ring is a queue: only its front leaves it, so moving an entry to
+    // the back renumbers it.
+    static void MoveFrontToBack(Shard& shard) {
+        Entry entry(std::move(shard.ring[0]));
+        shard.ring.PopFront();
+        ++shard.head;
+        shard.ring.PushBack(std::move(entry));
+        *shard.index.Find(shard.ring[shard.ring.Size() - 1].key) = shard.head + shard.ring.Size() - 1;
+    }
+
+    // Values leaving the cache are released only after the shard lock is
+    // dropped: the last reference may run an expensive destructor.
+    static void Defer(Vector<SharedPtr<V>>& released, SharedPtr<V>& value) {
+        if (released.Size() == released.Capacity()) {
+            released.Reserve(released.Capacity() == 0 ? 4 : released.Capacity() * 2);
+        }
+        released.Resize(released.Size() + 1);
+        released.Back() = std::move(value);
+    }
+
+    static void PopHole(Shard& shard) {
+        shard.ring.PopFront();
+        ++shard.head;
+    }
+
+    bool OverCapacity(const Shard& shard) const {
+        return shard.entries > max_entries_ || (max_bytes_ != 0 && shard.bytes > max_bytes_);
+    }
+
+    // Runs the clock hand until the shard fits. Every live entry is passed
+    // at most twice (once to clear its bit), so this ends.
+    void Evict(Shard& shard, Vector<SharedPtr<V>>& released) {
+        while (OverCapacity(shard)) {
+            Entry& front = shard.ring[0];
+            if (!front.live) {
+                PopHole(shard);
+            } else if (front.referenced.load(std::memory_order_relaxed)) {
+                front.referenced.store(false, std::memory_order_relaxed);
+                MoveFrontToBack(shard);
+            } else {
+                shard.index.Erase(front.key);
+                shard.entries -= 1;
+                shard.bytes -= front.bytes;
+                Defer(released, front.value);
+                PopHole(shard);
+                shard.evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Rebuilds the ring without holes once they outnumber the live entries,
+    // so that a workload of inserts and erases that never fills the cache
+    // does not grow it without bound.
+    static void Compact(Shard& shard) {
+        if (shard.ring.Size() - shard.entries <= shard.entries) {
+            return;
+        }
+
+        Deque<Entry> ring(shard.ring.Resource());
+        uint64_t head = shard.head + shard.ring.Size();
+        while (shard.ring.Size() > 0) {
+            Entry& front = shard.ring[0];
+            if (front.live) {
+                *shard.index.Find(front.key) = head + ring.Size();
+                ring.PushBack(std::move(front));
+            }
+            shard.ring.PopFront();
+        }
+        shard.ring.Swap(ring);
+        shard.head = head;
+    }
+
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t res = 1;
+        while (res < value) {
+            res *= 2;
+        }
+        return res;
+    }
+
+public:
+    explicit LruCache(const LruCacheOptions& options = LruCacheOptions()) {
+        size_t shards = RoundUpToPowerOfTwo(options.shards == 0 ? 1 : options.shards);
+        shards_ = MakeUnique<Shard[]>(shards);
+        shard_mask_ = shards - 1;
+        max_entries_ = (options.max_entries + shards - 1) / shards;
+        if (max_entries_ == 0) {
+            max_entries_ = 1;
+        }
+        max_bytes_ = (options.max_bytes + shards - 1) / shards;
+    }
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    size_t ShardCount() const {
+        return shard_mask_ + 1;
+    }
+
+    // Empty SharedPtr on a miss.
+    SharedPtr<V> Get(const K& key) {
+        Shard& shard = ShardFor(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        const uint64_t* number = shard.index.Find(key);
+        if (number == nullptr) {
+            shard.misses.fetch_add(1, std::memory_order_relaxed);
+            return SharedPtr<V>();
+        }
+
+        const Entry& entry = At(shard, *number);
+        // Most hits find the bit already set; skip the store then so the
+        // line is not dirtied.
+        if (!entry.referenced.load(std::memory_order_relaxed)) {
+            entry.referenced.store(true, std::memory_order_relaxed);
+        }
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return entry.value;
+    }
+
+    // Inserts or replaces; readers of a replaced value keep the old one.
+    // Throws std::invalid_argument for an empty value.
+    void Put(const K& key, SharedPtr<V> value) {
+        if (!value) {
+            throw std::invalid_argument("LruCache: cannot cache an empty value");
+        }
+        size_t bytes = size_of_(*value);
+        Shard& shard = ShardFor(key);
+        // Declared before the lock, so destroyed after the unlock.
+        Vector<SharedPtr<V>> released;
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+        const uint64_t* number = shard.index.Find(key);
+        if (number != nullptr) {
+            Entry& entry = At(shard, *number);
+            shard.bytes = shard.bytes - entry.bytes + bytes;
+            entry.bytes = bytes;
+            entry.referenced.store(true, std::memory_order_relaxed);
+            Defer(released, entry.value);
+            entry.value = std::move(value);
+            Evict(shard, released);
+            return;
+        }
+
+        shard.index.Insert(key, shard.head + shard.ring.Size());
+        shard.ring.PushBack(Entry(key, std::move(value), bytes));
+        shard.entries += 1;
+        shard.bytes += bytes;
+        shard.insertions.fetch_add(1, std::memory_order_relaxed);
+        Evict(shard, released);
+    }
+
+    void Put(const K& key, const V& value) {
+        Put(key, MakeShared<V>(value));
+    }
+
+    // Read-through: on a miss calls load(key), which returns a V, and caches
+    // the result. load runs without the shard lock held, so two threads
+    // missing on the same key may both load it; the later Put wins.
+    template <class Load>
+    SharedPtr<V> GetOrLoad(const K& key, Load load) {
+        SharedPtr<V> value = Get(key);
+        if (value) {
+            return value;
+        }
+        value = MakeShared<V>(load(key));
+        Put(key, value);
+        return value;
+    }
+
+    // False if the key was not cached.
+    bool Erase(const K& key) {
+        Shard& shard = ShardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        const uint64_t* number = shard.index.Find(key);
+        if (number == nullptr) {
+            return false;
+        }
+
+        Entry& entry = At(shard, *number);
+        SharedPtr<V> old(std::move(entry.value));
+        entry.live = false;
+        shard.entries -= 1;
+        shard.bytes -= entry.bytes;
+        shard.index.Erase(key);
+        Compact(shard);
+        lock.unlock();
+        return true;
+    }
+
+    void Clear() {
+        for (size_t i = 0; i <= shard_mask_; ++i) {
+            Shard& shard = shards_[i];
+            // Emptied under the lock, destroyed after it.
+            Deque<Entry> ring(shard.ring.Resource());
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.index.Clear();
+            shard.head += shard.ring.Size();
+            shard.ring.Swap(ring);
+            shard.entries = 0;
+            shard.bytes = 0;
+        }
+    }
+
+    // Sums over the shards; not a consistent snapshot while other threads
+    // use the cache.
+    LruCacheStats Stats() const {
+        LruCacheStats stats;
+        for (size_t i = 0; i <= shard_mask_; ++i) {
+            Shard& shard = shards_[i];
+            stats.hits += shard.hits.load(std::memory_order_relaxed);
+            stats.misses += shard.misses.load(std::memory_order_relaxed);
+            stats.insertions += shard.insertions.load(std::memory_order_relaxed);
+            stats.evictions += shard.evictions.load(std::memory_order_relaxed);
+
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            stats.entries += shard.entries;
+            stats.bytes += shard.bytes;
+        }
+        return stats;
+    }
+
+    void ResetStats() {
+        for (size_t i = 0; i <= shard_mask_; ++i) {
+            shards_[i].hits.store(0, std::memory_order_relaxed);
+            shards_[i].misses.store(0, std::memory_order_relaxed);
+            shards_[i].insertions.store(0, std::memory_order_relaxed);
+            shards_[i].evictions.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif // LRU_CACHE_H
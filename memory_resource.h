@@ -0,0 +1,569 @@
+#ifndef MEMORY_RESOURCE_H
+#define MEMORY_RESOURCE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// Where containers get their memory from, in the spirit of std::pmr. Every
+// container here takes a MemoryResource* (DefaultResource() if none is given)
+// and keeps it for its whole life; copies go to DefaultResource() unless a
+// resource is passed explicitly, so a copy may outlive the original's arena.
+class MemoryResource {
+public:
+    virtual ~MemoryResource() = default;
+
+    void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        return DoAllocate(bytes, alignment);
+    }
+
+    void Deallocate(void* ptr, size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        DoDeallocate(ptr, bytes, alignment);
+    }
+
+    // Memory from one resource may be given back to the other.
+    bool IsEqual(const MemoryResource& other) const noexcept {
+        return this == &other || DoIsEqual(other);
+    }
+
+protected:
+    virtual void* DoAllocate(size_t bytes, size_t alignment) = 0;
+    virtual void DoDeallocate(void* ptr, size_t bytes, size_t alignment) = 0;
+
+    virtual bool DoIsEqual(const MemoryResource&) const noexcept {
+        return false;
+    }
+};
+
+// Global operator new/delete.
+class NewDeleteMemoryResource : public MemoryResource {
+protected:
+    void* DoAllocate(size_t bytes, size_t alignment) override {
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(bytes, std::align_val_t(alignment));
+        }
+        return ::operator new(bytes);
+    }
+
+    void DoDeallocate(void* ptr, size_t bytes, size_t alignment) override {
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(ptr, bytes, std::align_val_t(alignment));
+            return;
+        }
+        ::operator delete(ptr, bytes);
+    }
+
+    bool DoIsEqual(const MemoryResource& other) const noexcept override {
+        return dynamic_cast<const NewDeleteMemoryResource*>(&other) != nullptr;
+    }
+};
+
+inline MemoryResource* NewDeleteResource() {
+    static NewDeleteMemoryResource resource;
+    return &resource;
+}
+
+inline std::atomic<MemoryResource*>& DefaultResourceSlot() {
+    static std::atomic<MemoryResource*> resource(NewDeleteResource());
+    return resource;
+}
+
+inline MemoryResource* DefaultResource() {
+    return DefaultResourceSlot().load(std::memory_order_acquire);
+}
+
+// Returns the previous default; nullptr restores NewDeleteResource().
+inline MemoryResource* SetDefaultResource(MemoryResource* resource) {
+    if (resource == nullptr) {
+        resource = NewDeleteResource();
+    }
+    return DefaultResourceSlot().exchange(resource, std::memory_order_acq_rel);
+}
+
+inline size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//====== MonotonicArena ======//
+
+// Bump allocator: Allocate() moves a pointer, Deallocate() does nothing, and
+// everything goes back at once in Release() or the destructor. Chunks come
+// from upstream and double in size; an optional initial buffer (on the stack,
+// say) is used first. Not thread-safe.
+class MonotonicArena : public MemoryResource {
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    const static size_t kDefaultChunkSize = 4096;
+    const static size_t kGrowthFactor = 2;
+    const static size_t kHeaderSize = (sizeof(Chunk) + alignof(std::max_align_t) - 1) /
+                                      alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    MemoryResource* upstream_;
+    unsigned char* initial_buffer_;
+    size_t initial_size_;
+    size_t initial_chunk_size_;
+
+    Chunk* chunks_;
+    unsigned char* current_;
+    size_t left_;
+    size_t next_chunk_size_;
+
+    void NewChunk(size_t bytes, size_t alignment) {
+        size_t size = next_chunk_size_;
+        while (size < kHeaderSize + bytes + alignment) {
+            size *= kGrowthFactor;
+        }
+
+        Chunk* chunk = static_cast<Chunk*>(upstream_->Allocate(size, alignof(std::max_align_t)));
+        chunk->next = chunks_;
+        chunk->size = size;
+        chunks_ = chunk;
+
+        current_ = reinterpret_cast<unsigned char*>(chunk) + kHeaderSize;
+        left_ = size - kHeaderSize;
+        next_chunk_size_ = size * kGrowthFactor;
+    }
+
+public:
+    explicit MonotonicArena(size_t initial_chunk_size = kDefaultChunkSize,
+                            MemoryResource* upstream = NewDeleteResource())
+            : upstream_(upstream),
+              initial_buffer_(nullptr),
+              initial_size_(0),
+              initial_chunk_size_(initial_chunk_size),
+              chunks_(nullptr),
+              current_(nullptr),
+              left_(0),
+              next_chunk_size_(0) {
+        if (initial_chunk_size_ <= kHeaderSize) {
+            initial_chunk_size_ = kDefaultChunkSize;
+        }
+        next_chunk_size_ = initial_chunk_size_;
+    }
+
+    MonotonicArena(void* buffer, size_t size, MemoryResource* upstream = NewDeleteResource())
+            : MonotonicArena(kDefaultChunkSize, upstream) {
+        initial_buffer_ = static_cast<unsigned char*>(buffer);
+        initial_size_ = size;
+        current_ = initial_buffer_;
+        left_ = initial_size_;
+    }
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    ~MonotonicArena() override {
+        Release();
+    }
+
+    // Frees every chunk; all memory handed out so far becomes invalid.
+    void Release() {
+        while (chunks_ != nullptr) {
+            Chunk* next = chunks_->next;
+            upstream_->Deallocate(chunks_, chunks_->size, alignof(std::max_align_t));
+            chunks_ = next;
+        }
+
+        current_ = initial_buffer_;
+        left_ = initial_size_;
+        next_chunk_size_ = initial_chunk_size_;
+    }
+
+    MemoryResource* Upstream() const {
+        return upstream_;
+    }
+
+protected:
+    void* DoAllocate(size_t bytes, size_t alignment) override {
+        size_t padding = AlignUp(reinterpret_cast<uintptr_t>(current_), alignment) -
+                         reinterpret_cast<uintptr_t>(current_);
+        if (current_ == nullptr || padding + bytes > left_) {
+            NewChunk(bytes, alignment);
+            padding = AlignUp(reinterpret_cast<uintptr_t>(current_), alignment) -
+                      reinterpret_cast<uintptr_t>(current_);
+        }
+
+        void* res = current_ + padding;
+        current_ += padding + bytes;
+        left_ -= padding + bytes;
+        return res;
+    }
+
+    void DoDeallocate(void*, size_t, size_t) override {
+    }
+};
+
+//====== PoolResource ======//
+
+// Power-of-two size classes from 16 bytes to 4 KiB, each with a free list
+// carved out of chunks from upstream. Larger or over-aligned requests go
+// straight to upstream. Chunks are returned only by Release() or the
+// destructor. Not thread-safe; see ThreadCacheResource for that.
+class PoolResource : public MemoryResource {
+public:
+    const static size_t kMinBlockShift = 4;
+    const static size_t kClasses = 9;
+    const static size_t kMaxBlockSize = size_t(1) << (kMinBlockShift + kClasses - 1);
+
+    // Size class of a request, kClasses if it is not pooled.
+    static size_t ClassOf(size_t bytes, size_t alignment) {
+        if (bytes > kMaxBlockSize || alignment > alignof(std::max_align_t)) {
+            return kClasses;
+        }
+
+        size_t cls = 0;
+        while ((size_t(1) << (kMinBlockShift + cls)) < bytes) {
+            ++cls;
+        }
+        return cls;
+    }
+
+    static size_t ClassSize(size_t cls) {
+        return size_t(1) << (kMinBlockShift + cls);
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    const static size_t kChunkBytes = 16 * 1024;
+    const static size_t kHeaderSize = (sizeof(Chunk) + alignof(std::max_align_t) - 1) /
+                                      alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    MemoryResource* upstream_;
+    FreeBlock* free_[kClasses];
+    Chunk* chunks_;
+
+    void Refill(size_t cls) {
+        size_t block_size = ClassSize(cls);
+        size_t blocks = kChunkBytes / block_size > 0 ? kChunkBytes / block_size : 1;
+        size_t size = kHeaderSize + blocks * block_size;
+
+        Chunk* chunk = static_cast<Chunk*>(upstream_->Allocate(size, alignof(std::max_align_t)));
+        chunk->next = chunks_;
+        chunk->size = size;
+        chunks_ = chunk;
+
+        unsigned char* first = reinterpret_cast<unsigned char*>(chunk) + kHeaderSize;
+        for (size_t i = blocks; i > 0; --i) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(first + (i - 1) * block_size);
+            block->next = free_[cls];
+            free_[cls] = block;
+        }
+    }
+
+public:
+    explicit PoolResource(MemoryResource* upstream = NewDeleteResource()) : upstream_(upstream), chunks_(nullptr) {
+        for (size_t i = 0; i < kClasses; ++i) {
+            free_[i] = nullptr;
+        }
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource() override {
+        Release();
+    }
+
+    void Release() {
+        while (chunks_ != nullptr) {
+            Chunk* next = chunks_->next;
+            upstream_->Deallocate(chunks_, chunks_->size, alignof(std::max_align_t));
+            chunks_ = next;
+        }
+        for (size_t i = 0; i < kClasses; ++i) {
+            free_[i] = nullptr;
+        }
+    }
+
+    MemoryResource* Upstream() const {
+        return upstream_;
+    }
+
+protected:
+    void* DoAllocate(size_t bytes, size_t alignment) override {
+        size_t cls = ClassOf(bytes, alignment);
+        if (cls == kClasses) {
+            return upstream_->Allocate(bytes, alignment);
+        }
+
+        if (free_[cls] == nullptr) {
+            Refill(cls);
+        }
+        FreeBlock* block = free_[cls];
+        free_[cls] = block->next;
+        return block;
+    }
+
+    void DoDeallocate(void* ptr, size_t bytes, size_t alignment) override {
+        size_t cls = ClassOf(bytes, alignment);
+        if (cls == kClasses) {
+            upstream_->Deallocate(ptr, bytes, alignment);
+            return;
+        }
+
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = free_[cls];
+        free_[cls] = block;
+    }
+};
+
+//====== ThreadCacheResource ======//
+
+// Thread-safe pooling: each thread keeps short free lists per size class and
+// trades whole batches with one shared, mutex-protected PoolResource. Blocks
+// may be freed on any thread. The shared pool lives for the whole process, so
+// all instances are interchangeable and blocks outlive any instance.
+class ThreadCacheResource : public MemoryResource {
+    const static size_t kBatchSize = 32;
+    const static size_t kCacheLimit = 2 * kBatchSize;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct ClassCache {
+        FreeBlock* head;
+        size_t count;
+    };
+
+    // Trivial, so it stays usable while the thread is being torn down.
+    struct ThreadCache {
+        ClassCache classes[PoolResource::kClasses];
+        bool exited;
+    };
+
+    struct ThreadExitFlusher {
+        ~ThreadExitFlusher() {
+            ThreadCache& cache = Cache();
+            std::lock_guard<std::mutex> lock(Mutex());
+            for (size_t cls = 0; cls < PoolResource::kClasses; ++cls) {
+                while (cache.classes[cls].head != nullptr) {
+                    FreeBlock* block = cache.classes[cls].head;
+                    cache.classes[cls].head = block->next;
+                    Shared().Deallocate(block, PoolResource::ClassSize(cls));
+                }
+                cache.classes[cls].count = 0;
+            }
+            cache.exited = true;
+        }
+    };
+
+    static std::mutex& Mutex() {
+        static std::mutex* mutex = new std::mutex;
+        return *mutex;
+    }
+
+    // Never destroyed: threads may still free blocks during static destruction.
+    static PoolResource& Shared() {
+        static PoolResource* shared = new PoolResource;
+        return *shared;
+    }
+
+    static ThreadCache& Cache() {
+        static thread_local ThreadCache cache = {};
+        return cache;
+    }
+
+    static void RegisterFlusher() {
+        static thread_local ThreadExitFlusher flusher;
+        (void)flusher;
+    }
+
+protected:
+    void* DoAllocate(size_t bytes, size_t alignment) override {
+        size_t cls = PoolResource::ClassOf(bytes, alignment);
+        if (cls == PoolResource::kClasses) {
+            return NewDeleteResource()->Allocate(bytes, alignment);
+        }
+
+        ThreadCache& cache = Cache();
+        ClassCache& list = cache.classes[cls];
+        if (list.head == nullptr) {
+            if (cache.exited) {
+                std::lock_guard<std::mutex> lock(Mutex());
+                return Shared().Allocate(PoolResource::ClassSize(cls));
+            }
+
+            RegisterFlusher();
+            std::lock_guard<std::mutex> lock(Mutex());
+            for (size_t i = 0; i < kBatchSize; ++i) {
+                FreeBlock* block = static_cast<FreeBlock*>(Shared().Allocate(PoolResource::ClassSize(cls)));
+                block->next = list.head;
+                list.head = block;
+            }
+            list.count = kBatchSize;
+        }
+
+        FreeBlock* block = list.head;
+        list.head = block->next;
+        --list.count;
+        return block;
+    }
+
+    void DoDeallocate(void* ptr, size_t bytes, size_t alignment) override {
+        size_t cls = PoolResource::ClassOf(bytes, alignment);
+        if (cls == PoolResource::kClasses) {
+            NewDeleteResource()->Deallocate(ptr, bytes, alignment);
+            return;
+        }
+
+        ThreadCache& cache = Cache();
+        if (cache.exited) {
+            std::lock_guard<std::mutex> lock(Mutex());
+            Shared().Deallocate(ptr, PoolResource::ClassSize(cls));
+            return;
+        }
+
+        ClassCache& list = cache.classes[cls];
+        if (list.head == nullptr) {
+            RegisterFlusher();
+        }
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+
+        if (list.count < kCacheLimit) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(Mutex());
+        for (size_t i = 0; i < kBatchSize; ++i) {
+            FreeBlock* spilled = list.head;
+            list.head = spilled->next;
+            Shared().Deallocate(spilled, PoolResource::ClassSize(cls));
+        }
+        list.count -= kBatchSize;
+    }
+
+    bool DoIsEqual(const MemoryResource& other) const noexcept override {
+        return dynamic_cast<const ThreadCacheResource*>(&other) != nullptr;
+    }
+};
+
+//====== PolymorphicAllocator ======//
+
+// Standard allocator interface over a MemoryResource, for AllocateShared and
+// anything else that is templated on an allocator.
+template<class T>
+class PolymorphicAllocator {
+    MemoryResource* resource_;
+
+public:
+    using value_type = T;
+
+    PolymorphicAllocator() noexcept : resource_(DefaultResource()) {
+    }
+
+    PolymorphicAllocator(MemoryResource* resource) noexcept : resource_(resource) {
+    }
+
+    template<class U>
+    PolymorphicAllocator(const PolymorphicAllocator<U>& other) noexcept : resource_(other.Resource()) {
+    }
+
+    T* allocate(size_t count) {
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(resource_->Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t count) {
+        resource_->Deallocate(ptr, count * sizeof(T), alignof(T));
+    }
+
+    // Copied containers do not inherit the resource.
+    PolymorphicAllocator select_on_container_copy_construction() const {
+        return PolymorphicAllocator();
+    }
+
+    MemoryResource* Resource() const {
+        return resource_;
+    }
+};
+
+template<class T, class U>
+bool operator==(const PolymorphicAllocator<T>& lhs, const PolymorphicAllocator<U>& rhs) {
+    return lhs.Resource()->IsEqual(*rhs.Resource());
+}
+
+template<class T, class U>
+bool operator!=(const PolymorphicAllocator<T>& lhs, const PolymorphicAllocator<U>& rhs) {
+    return !(lhs == rhs);
+}
+
+//====== new / delete through a resource ======//
+
+// new T[count]: default-initialized elements, nullptr for count == 0.
+template<class T>
+T* NewArray(MemoryResource* resource, size_t count) {
+    if (count == 0) {
+        return nullptr;
+    }
+
+    T* data = static_cast<T*>(resource->Allocate(count * sizeof(T), alignof(T)));
+    size_t constructed = 0;
+    try {
+        for (; constructed < count; ++constructed) {
+            new (data + constructed) T;
+        }
+    } catch (...) {
+        while (constructed > 0) {
+            data[--constructed].~T();
+        }
+        resource->Deallocate(data, count * sizeof(T), alignof(T));
+        throw;
+    }
+    return data;
+}
+
+// delete[] for NewArray; count must be the one passed to NewArray.
+template<class T>
+void DeleteArray(MemoryResource* resource, T* data, size_t count) {
+    if (data == nullptr) {
+        return;
+    }
+
+    for (size_t i = count; i > 0; --i) {
+        data[i - 1].~T();
+    }
+    resource->Deallocate(data, count * sizeof(T), alignof(T));
+}
+
+template<class T, class... Args>
+T* NewObject(MemoryResource* resource, Args&&... args) {
+    void* memory = resource->Allocate(sizeof(T), alignof(T));
+    try {
+        return new (memory) T(std::forward<Args>(args)...);
+    } catch (...) {
+        resource->Deallocate(memory, sizeof(T), alignof(T));
+        throw;
+    }
+}
+
+template<class T>
+void DeleteObject(MemoryResource* resource, T* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    ptr->~T();
+    resource->Deallocate(ptr, sizeof(T), alignof(T));
+}
+
+#endif // MEMORY_RESOURCE_H
@@ -0,0 +1,262 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Bounded multi-producer multi-consumer queue (D. Vyukov's design).
+// Every slot carries a sequence number telling whose turn it is: a producer
+// may fill slot i when sequence == pos, a consumer may drain it when
+// sequence == pos + 1. Positions are claimed with a single CAS, so neither
+// side ever takes a lock. The mutex/condition pair below is only touched by
+// the blocking Push/Pop after spinning has stopped paying off.
+//
+// A popped element is moved out before its slot is handed back, so T must
+// be nothrow movable: a throw there would leave the slot claimed forever.
+// The optional-returning TryPop()/Pop() need no default constructor.
+template <class T>
+class MPMCQueue {
+    static_assert(std::is_nothrow_move_constructible<T>::value, "MPMCQueue needs a nothrow move constructor");
+
+    const static size_t kCacheLine = 64;
+    const static int kSpinCount = 128;
+    const static int kYieldCount = 16;
+
+    struct alignas(kCacheLine) Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* Value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    Slot* slots_;
+    size_t mask_;
+
+    alignas(kCacheLine) std::atomic<size_t> enqueue_pos_;
+    alignas(kCacheLine) std::atomic<size_t> dequeue_pos_;
+
+    alignas(kCacheLine) std::atomic<size_t> push_waiters_;
+    std::atomic<size_t> pop_waiters_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t res = 2;
+        while (res < value) {
+            res <<= 1;
+        }
+        return res;
+    }
+
+    template <class U>
+    bool Enqueue(U&& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        while (true) {
+            slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (slot->storage) T(std::forward<U>(value));
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // sink(T&&) takes the element and must not throw.
+    template <class Sink>
+    bool Dequeue(Sink sink) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        while (true) {
+            slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        T* stored = slot->Value();
+        sink(std::move(*stored));
+        stored->~T();
+        slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // The fence pairs with the one in Wait(): either the waiter sees our
+    // update on its re-check, or we see its registration here. Must not be
+    // called while holding mutex_.
+    void Notify(std::atomic<size_t>& waiters, std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv.notify_all();
+    }
+
+    template <class Try>
+    void Wait(std::atomic<size_t>& waiters, std::condition_variable& cv, Try try_op) {
+        for (int i = 0; i < kSpinCount; ++i) {
+            if (try_op()) {
+                return;
+            }
+        }
+
+        for (int i = 0; i < kYieldCount; ++i) {
+            std::this_thread::yield();
+            if (try_op()) {
+                return;
+            }
+        }
+
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!try_op()) {
+            cv.wait(lock);
+        }
+        lock.unlock();
+
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+public:
+    explicit MPMCQueue(size_t capacity)
+            : slots_(nullptr),
+              mask_(RoundUpToPowerOfTwo(capacity) - 1),
+              enqueue_pos_(0),
+              dequeue_pos_(0),
+              push_waiters_(0),
+              pop_waiters_(0) {
+        slots_ = new Slot[mask_ + 1];
+        for (size_t i = 0; i <= mask_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    ~MPMCQueue() {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t end = enqueue_pos_.load(std::memory_order_relaxed);
+        for (; pos != end; ++pos) {
+            slots_[pos & mask_].Value()->~T();
+        }
+
+        delete[] slots_;
+    }
+
+    size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+    // Only a snapshot: other threads may change it right after the call.
+    size_t Size() const {
+        size_t tail = dequeue_pos_.load(std::memory_order_acquire);
+        size_t head = enqueue_pos_.load(std::memory_order_acquire);
+        return head > tail ? head - tail : 0;
+    }
+
+    bool Empty() const {
+        return Size() == 0;
+    }
+
+    bool TryPush(const T& value) {
+        if (!Enqueue(value)) {
+            return false;
+        }
+        Notify(pop_waiters_, not_empty_);
+        return true;
+    }
+
+    bool TryPush(T&& value) {
+        if (!Enqueue(std::move(value))) {
+            return false;
+        }
+        Notify(pop_waiters_, not_empty_);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        static_assert(std::is_nothrow_move_assignable<T>::value, "TryPop(T&) needs a nothrow move assignment");
+        if (!Dequeue([&](T&& taken) { value = std::move(taken); })) {
+            return false;
+        }
+        Notify(push_waiters_, not_full_);
+        return true;
+    }
+
+    // Empty if the queue was.
+    std::optional<T> TryPop() {
+        std::optional<T> res;
+        if (!Dequeue([&](T&& taken) { res.emplace(std::move(taken)); })) {
+            return res;
+        }
+        Notify(push_waiters_, not_full_);
+        return res;
+    }
+
+    void Push(const T& value) {
+        Wait(push_waiters_, not_full_, [&] { return Enqueue(value); });
+        Notify(pop_waiters_, not_empty_);
+    }
+
+    void Push(T&& value) {
+        Wait(push_waiters_, not_full_, [&] { return Enqueue(std::move(value)); });
+        Notify(pop_waiters_, not_empty_);
+    }
+
+    void Pop(T& value) {
+        static_assert(std::is_nothrow_move_assignable<T>::value, "Pop(T&) needs a nothrow move assignment");
+        Wait(pop_waiters_, not_empty_, [&] {
+            return Dequeue([&](T&& taken) { value = std::move(taken); });
+        });
+        Notify(push_waiters_, not_full_);
+    }
+
+    T Pop() {
+        std::optional<T> res;
+        Wait(pop_waiters_, not_empty_, [&] {
+            return Dequeue([&](T&& taken) { res.emplace(std::move(taken)); });
+        });
+        Notify(push_waiters_, not_full_);
+        return std::move(*res);
+    }
+};
+
+#endif // MPMC_QUEUE_H
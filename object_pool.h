@@ -0,0 +1,314 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include "function.h"
+#include "unique_ptr.h"
+#include "vector.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+template<class T>
+class ObjectPool;
+
+// Gives the object back to its pool instead of deleting it.
+template<class T>
+struct PoolDeleter {
+    ObjectPool<T>* pool = nullptr;
+
+    void operator()(T* ptr) const {
+        pool->Return(ptr);
+    }
+};
+
+template<class T>
+using PoolPtr = UniquePtr<T, PoolDeleter<T>>;
+
+struct ObjectPoolOptions {
+    // Objects created up front, before the first Acquire().
+    size_t warm_up = 0;
+    // Idle objects kept by each thread; half of them move to the shared list
+    // when the limit is hit.
+    size_t max_cached_per_thread = 256;
+    // Idle objects in the shared list; returns beyond that are deleted.
+    size_t max_cached_shared = 4096;
+};
+
+// Pool of reusable T (request contexts, buffers) handed out as PoolPtr<T>.
+// Dropping a handle resets the object (with the reset function, or by
+// assigning T() when there is none) and returns it to the dropping thread's
+// free list, so objects may be returned on any thread. Free lists are
+// refilled from and spilled into a mutex-protected shared list in batches.
+// The cache of an exited thread goes, with its objects, to the next thread
+// that needs one, so thread churn does not grow the pool. The pool must
+// outlive every handle.
+template<class T>
+class ObjectPool {
+    // Shared by the pool and the thread using it; whichever lets go last
+    // deletes it. orphaned is set once that thread has exited.
+    struct Cache {
+        uint64_t pool_id;
+        Vector<T*> objects;
+        std::atomic<int> refs{2};
+        std::atomic<bool> orphaned{false};
+    };
+
+    static void Release(Cache* cache) {
+        if (cache->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete cache;
+        }
+    }
+
+    // The caches a thread uses, over all pools of T; orphaned when the
+    // thread exits.
+    struct ThreadCaches {
+        Vector<Cache*> caches;
+
+        // Drops caches whose pool is gone (only this thread holds them).
+        void Add(Cache* cache) {
+            size_t kept = 0;
+            for (size_t i = 0; i < caches.Size(); ++i) {
+                if (caches[i]->refs.load(std::memory_order_acquire) == 1) {
+                    delete caches[i];
+                } else {
+                    caches[kept++] = caches[i];
+                }
+            }
+            caches.Resize(kept);
+            caches.PushBack(cache);
+        }
+
+        // The memos are cleared too: another thread may adopt these caches
+        // right away. Handles dropped later on this thread (from other
+        // thread_local destructors) go to the shared list.
+        ~ThreadCaches() {
+            Exited() = true;
+            Memo* memos = Memos();
+            for (size_t i = 0; i < kMemoSize; ++i) {
+                memos[i] = Memo{};
+            }
+            for (size_t i = 0; i < caches.Size(); ++i) {
+                caches[i]->orphaned.store(true, std::memory_order_release);
+                Release(caches[i]);
+            }
+        }
+    };
+
+    // Per-thread shortcut from a pool to that thread's cache; ids are never
+    // reused, so entries left by destroyed pools simply never match.
+    struct Memo {
+        uint64_t pool_id;
+        Cache* cache;
+    };
+
+    const static size_t kMemoSize = 4;
+
+    uint64_t id_;
+    ObjectPoolOptions options_;
+    Function<void(T&)> reset_;
+
+    std::mutex mutex_;
+    Vector<T*> shared_;
+    Vector<Cache*> caches_;
+
+    static uint64_t NextId() {
+        static std::atomic<uint64_t> next_id(1);
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static Memo* Memos() {
+        static thread_local Memo memos[kMemoSize] = {};
+        return memos;
+    }
+
+    static bool& Exited() {
+        static thread_local bool exited = false;
+        return exited;
+    }
+
+    // Kept apart from the memos so that the fast path does not pay for a
+    // thread_local with a destructor.
+    static ThreadCaches& OwnCaches() {
+        static thread_local ThreadCaches caches;
+        return caches;
+    }
+
+    // A thread's first call adopts the cache of an exited thread if there
+    // is one, and makes a new cache otherwise. nullptr once the thread's
+    // caches are gone.
+    Cache* LocalCache() {
+        Memo& memo = Memos()[id_ % kMemoSize];
+        if (memo.pool_id == id_) {
+            return memo.cache;
+        }
+        if (Exited()) {
+            return nullptr;
+        }
+
+        ThreadCaches& own = OwnCaches();
+        Cache* cache = nullptr;
+        for (size_t i = 0; i < own.caches.Size() && cache == nullptr; ++i) {
+            if (own.caches[i]->pool_id == id_) {
+                cache = own.caches[i];
+            }
+        }
+        if (cache != nullptr) {
+            memo.pool_id = id_;
+            memo.cache = cache;
+            return cache;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < caches_.Size() && cache == nullptr; ++i) {
+                if (caches_[i]->orphaned.load(std::memory_order_acquire)) {
+                    cache = caches_[i];
+                    cache->orphaned.store(false, std::memory_order_relaxed);
+                    cache->refs.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            if (cache == nullptr) {
+                cache = new Cache;
+                cache->pool_id = id_;
+                cache->objects.Reserve(options_.max_cached_per_thread);
+                caches_.PushBack(cache);
+            }
+        }
+        own.Add(cache);
+
+        memo.pool_id = id_;
+        memo.cache = cache;
+        return cache;
+    }
+
+    size_t BatchSize() const {
+        return options_.max_cached_per_thread / 2 > 0 ? options_.max_cached_per_thread / 2 : 1;
+    }
+
+    // For a thread whose caches are gone.
+    T* TakeShared() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!shared_.Empty()) {
+                T* ptr = shared_.Back();
+                shared_.PopBack();
+                return ptr;
+            }
+        }
+        return new T();
+    }
+
+    void Refill(Cache& cache) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < BatchSize() && !shared_.Empty(); ++i) {
+            cache.objects.PushBack(shared_.Back());
+            shared_.PopBack();
+        }
+    }
+
+    // Moves the cache down to half its limit; what the shared list cannot
+    // take is deleted.
+    void Spill(Cache& cache) {
+        size_t keep = options_.max_cached_per_thread / 2;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (cache.objects.Size() > keep && shared_.Size() < options_.max_cached_shared) {
+                shared_.PushBack(cache.objects.Back());
+                cache.objects.PopBack();
+            }
+        }
+        while (cache.objects.Size() > keep) {
+            delete cache.objects.Back();
+            cache.objects.PopBack();
+        }
+    }
+
+    void Return(T* ptr) {
+        if (reset_) {
+            reset_(*ptr);
+        } else {
+            *ptr = T();
+        }
+
+        Cache* cache = LocalCache();
+        if (cache != nullptr) {
+            if (cache->objects.Size() >= options_.max_cached_per_thread) {
+                Spill(*cache);
+            }
+            if (cache->objects.Size() < options_.max_cached_per_thread) {
+                cache->objects.PushBack(ptr);
+                return;
+            }
+        }
+
+        // No per-thread caching at all, or the thread is exiting.
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (shared_.Size() < options_.max_cached_shared) {
+            shared_.PushBack(ptr);
+            return;
+        }
+        lock.unlock();
+        delete ptr;
+    }
+
+    friend struct PoolDeleter<T>;
+
+public:
+    explicit ObjectPool(ObjectPoolOptions options = ObjectPoolOptions(), Function<void(T&)> reset = nullptr)
+            : id_(NextId()), options_(options), reset_(std::move(reset)) {
+        shared_.Reserve(options_.max_cached_shared > options_.warm_up ? options_.max_cached_shared
+                                                                      : options_.warm_up);
+        for (size_t i = 0; i < options_.warm_up; ++i) {
+            shared_.PushBack(new T());
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Every handle must have been dropped, and no other thread may use the
+    // pool any more.
+    ~ObjectPool() {
+        for (size_t i = 0; i < shared_.Size(); ++i) {
+            delete shared_[i];
+        }
+        for (size_t i = 0; i < caches_.Size(); ++i) {
+            for (size_t j = 0; j < caches_[i]->objects.Size(); ++j) {
+                delete caches_[i]->objects[j];
+            }
+            caches_[i]->objects.Clear();
+            Release(caches_[i]);
+        }
+    }
+
+    // A cached object if there is one, a new T() otherwise.
+    PoolPtr<T> Acquire() {
+        Cache* cache = LocalCache();
+        if (cache == nullptr) {
+            return PoolPtr<T>(TakeShared(), PoolDeleter<T>{this});
+        }
+        if (cache->objects.Empty()) {
+            Refill(*cache);
+        }
+
+        T* ptr = nullptr;
+        if (cache->objects.Empty()) {
+            ptr = new T();
+        } else {
+            ptr = cache->objects.Back();
+            cache->objects.PopBack();
+        }
+        return PoolPtr<T>(ptr, PoolDeleter<T>{this});
+    }
+
+    // Idle objects in the shared list (per-thread caches not included).
+    size_t SharedSize() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return shared_.Size();
+    }
+};
+
+#endif // OBJECT_POOL_H
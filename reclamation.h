@@ -0,0 +1,356 @@
+#ifndef RECLAMATION_H
+#define RECLAMATION_H
+
+#include "unique_ptr.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+// Deferred reclamation for lock-free structures: a node unlinked by one thread
+// may still be read by others, so it is Retire()d instead of deleted and freed
+// once no reader can hold it. Two schemes with the same interface:
+//
+//  - EpochReclaimer: readers only announce an epoch when entering a Guard,
+//    which makes reads nearly free, but one stalled reader holds back every
+//    retired node.
+//  - HazardPointers: readers publish each pointer they are about to use, which
+//    costs a fence per Protect(), but memory held back is bounded.
+//
+// Both keep a retire list per thread and free in batches. A thread that exits
+// leaves its record, pending nodes included, to the next thread that starts.
+
+struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+template<class T>
+void DeleteRetired(void* ptr) {
+    delete static_cast<T*>(ptr);
+}
+
+// For a UniquePtr's deleter, which has to be stateless: only a function
+// pointer is kept per retired node.
+template<class T, class Deleter>
+void DeleteRetiredWith(void* ptr) {
+    Deleter()(static_cast<T*>(ptr));
+}
+
+// Push-only lock-free list of per-thread records. Records are never freed;
+// a released one is adopted by the next thread that asks.
+template<class Record>
+class ThreadRegistry {
+    std::atomic<Record*> head_;
+    std::atomic<size_t> size_;
+
+public:
+    ThreadRegistry() : head_(nullptr), size_(0) {
+    }
+
+    Record* Acquire() {
+        for (Record* record = Head(); record != nullptr; record = record->next) {
+            bool expected = false;
+            if (!record->in_use.load(std::memory_order_relaxed) &&
+                record->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        Record* record = new Record;
+        record->in_use.store(true, std::memory_order_relaxed);
+        Record* head = head_.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!head_.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    void Release(Record* record) {
+        record->in_use.store(false, std::memory_order_release);
+    }
+
+    Record* Head() const {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    size_t Size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+};
+
+// Frees the entries of retired for which can_free(entry) holds, keeping the rest.
+template<class Predicate>
+void FreeRetired(Vector<Retired>& retired, Predicate can_free) {
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.Size(); ++i) {
+        if (can_free(retired[i])) {
+            retired[i].deleter(retired[i].ptr);
+        } else {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.Resize(kept);
+}
+
+//====== Epoch-based reclamation ======//
+
+// The global epoch advances once every thread inside a Guard has seen the
+// current one. A node retired in epoch e is unreachable for readers that
+// entered in e + 1 or later, so it is freed once the epoch reaches e + 2.
+class EpochReclaimer {
+    const static size_t kBatchSize = 64;
+
+    struct Record {
+        Record* next = nullptr;
+        std::atomic<bool> in_use{false};
+        // (epoch << 1) | 1 while inside a Guard, 0 otherwise.
+        std::atomic<uint64_t> state{0};
+        size_t depth = 0;
+        Vector<Retired> retired;
+    };
+
+    struct LocalRecord {
+        Record* record;
+
+        LocalRecord() : record(Registry().Acquire()) {
+        }
+
+        ~LocalRecord() {
+            Collect(record);
+            Registry().Release(record);
+        }
+    };
+
+    static std::atomic<uint64_t>& GlobalEpoch() {
+        static std::atomic<uint64_t> epoch(1);
+        return epoch;
+    }
+
+    static ThreadRegistry<Record>& Registry() {
+        static ThreadRegistry<Record> registry;
+        return registry;
+    }
+
+    static Record* Local() {
+        static thread_local LocalRecord local;
+        return local.record;
+    }
+
+    static void TryAdvance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t epoch = GlobalEpoch().load(std::memory_order_relaxed);
+        for (Record* record = Registry().Head(); record != nullptr; record = record->next) {
+            uint64_t state = record->state.load(std::memory_order_acquire);
+            if ((state & 1) != 0 && (state >> 1) != epoch) {
+                return;
+            }
+        }
+        GlobalEpoch().compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+    }
+
+    static void Collect(Record* record) {
+        TryAdvance();
+        uint64_t epoch = GlobalEpoch().load(std::memory_order_acquire);
+        FreeRetired(record->retired, [epoch](const Retired& entry) {
+            return entry.epoch + 2 <= epoch;
+        });
+    }
+
+public:
+    // Pins the current epoch: nothing retired from now on is freed while any
+    // Guard is alive. Guards nest.
+    class Guard {
+        Record* record_;
+
+    public:
+        Guard() : record_(Local()) {
+            if (record_->depth++ == 0) {
+                uint64_t epoch = GlobalEpoch().load(std::memory_order_relaxed);
+                record_->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard() {
+            if (--record_->depth == 0) {
+                record_->state.store(0, std::memory_order_release);
+            }
+        }
+    };
+
+    // ptr must already be unreachable for readers that start from now on.
+    static void Retire(void* ptr, void (*deleter)(void*)) {
+        Record* record = Local();
+        uint64_t epoch = GlobalEpoch().load(std::memory_order_seq_cst);
+        record->retired.PushBack(Retired{ptr, deleter, epoch});
+        if (record->retired.Size() % kBatchSize == 0) {
+            Collect(record);
+        }
+    }
+
+    template<class T>
+    static void Retire(T* ptr) {
+        Retire(ptr, &DeleteRetired<T>);
+    }
+
+    // Frees with the pointer's own deleter (delete[] for UniquePtr<T[]>).
+    template<class T, class Deleter>
+    static void Retire(UniquePtr<T, Deleter> ptr) {
+        static_assert(std::is_empty<Deleter>::value && std::is_default_constructible<Deleter>::value,
+                      "Retire() can only carry a stateless deleter");
+        Retire(ptr.Release(), &DeleteRetiredWith<std::remove_extent_t<T>, Deleter>);
+    }
+
+    // Frees whatever this thread can free right now.
+    static void Flush() {
+        Collect(Local());
+    }
+};
+
+//====== Hazard pointers ======//
+
+// Each thread owns kSlots hazard slots. A reader stores the pointer it is
+// about to dereference into a slot and re-checks the source; a retired node
+// is freed only once it appears in no slot of any thread.
+class HazardPointers {
+    const static size_t kSlots = 4;
+    const static size_t kBatchSize = 64;
+
+    struct Record {
+        Record* next = nullptr;
+        std::atomic<bool> in_use{false};
+        std::atomic<void*> hazards[kSlots] = {};
+        bool taken[kSlots] = {};
+        Vector<Retired> retired;
+    };
+
+    struct LocalRecord {
+        Record* record;
+
+        LocalRecord() : record(Registry().Acquire()) {
+        }
+
+        ~LocalRecord() {
+            Scan(record);
+            Registry().Release(record);
+        }
+    };
+
+    static ThreadRegistry<Record>& Registry() {
+        static ThreadRegistry<Record> registry;
+        return registry;
+    }
+
+    static Record* Local() {
+        static thread_local LocalRecord local;
+        return local.record;
+    }
+
+    static void Scan(Record* record) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        Vector<void*> hazards;
+        hazards.Reserve(Registry().Size() * kSlots);
+        for (Record* other = Registry().Head(); other != nullptr; other = other->next) {
+            for (size_t i = 0; i < kSlots; ++i) {
+                void* hazard = other->hazards[i].load(std::memory_order_acquire);
+                if (hazard != nullptr) {
+                    hazards.PushBack(hazard);
+                }
+            }
+        }
+
+        void** begin = hazards.Empty() ? nullptr : &hazards[0];
+        void** end = begin + hazards.Size();
+        std::sort(begin, end);
+        FreeRetired(record->retired, [begin, end](const Retired& entry) {
+            return !std::binary_search(begin, end, entry.ptr);
+        });
+    }
+
+public:
+    // Owns one hazard slot of the calling thread until destroyed.
+    class Guard {
+        Record* record_;
+        size_t slot_;
+
+    public:
+        Guard() : record_(Local()), slot_(0) {
+            while (slot_ < kSlots && record_->taken[slot_]) {
+                ++slot_;
+            }
+            if (slot_ == kSlots) {
+                throw std::length_error("HazardPointers: too many guards in one thread");
+            }
+            record_->taken[slot_] = true;
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard() {
+            Reset();
+            record_->taken[slot_] = false;
+        }
+
+        // Loads source and protects the result; it stays valid until the
+        // guard is reset or protects something else.
+        template<class T>
+        T* Protect(const std::atomic<T*>& source) {
+            T* ptr = source.load(std::memory_order_relaxed);
+            while (true) {
+                record_->hazards[slot_].store(ptr, std::memory_order_seq_cst);
+                T* current = source.load(std::memory_order_acquire);
+                if (current == ptr) {
+                    return ptr;
+                }
+                ptr = current;
+            }
+        }
+
+        void Reset() {
+            record_->hazards[slot_].store(nullptr, std::memory_order_release);
+        }
+    };
+
+    static void Retire(void* ptr, void (*deleter)(void*)) {
+        Record* record = Local();
+        record->retired.PushBack(Retired{ptr, deleter, 0});
+
+        // Scanning costs O(threads * kSlots), so let the list outgrow that
+        // and every scan frees at least half of it.
+        size_t threshold = 2 * kSlots * Registry().Size();
+        if (record->retired.Size() >= threshold && record->retired.Size() >= kBatchSize) {
+            Scan(record);
+        }
+    }
+
+    template<class T>
+    static void Retire(T* ptr) {
+        Retire(ptr, &DeleteRetired<T>);
+    }
+
+    // Frees with the pointer's own deleter (delete[] for UniquePtr<T[]>).
+    template<class T, class Deleter>
+    static void Retire(UniquePtr<T, Deleter> ptr) {
+        static_assert(std::is_empty<Deleter>::value && std::is_default_constructible<Deleter>::value,
+                      "Retire() can only carry a stateless deleter");
+        Retire(ptr.Release(), &DeleteRetiredWith<std::remove_extent_t<T>, Deleter>);
+    }
+
+    static void Flush() {
+        Scan(Local());
+    }
+};
+
+#endif // RECLAMATION_H
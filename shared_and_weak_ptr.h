@@ -1,10 +1,17 @@
 #ifndef SHARED_PTR_SHARED_PTR_H
 #define SHARED_PTR_SHARED_PTR_H
 
+#include "control_block_pool.h"
+#include "instrumentation.h"
+
+#include <atomic>
 #include <cstdlib>
 #include <utility>
 #include <exception>
+#include <memory>
+#include <new>
 #include <string>
+#include <type_traits>
 
 class BadWeakPtr : public std::exception {
     std::string message_;
@@ -23,31 +30,302 @@ public:
     }
 };
 
-template<class T>
+// Reference-count policies. Decrement() returns the new value.
+struct AtomicRefCount {
+    using Count = std::atomic<size_t>;
+
+    static void Increment(Count& count) {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // acq_rel: every access through other owners happens before the
+    // destruction triggered by the final decrement.
+    static size_t Decrement(Count& count) {
+        return count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+
+    static size_t Load(const Count& count) {
+        return count.load(std::memory_order_acquire);
+    }
+
+    static bool IncrementIfNotZero(Count& count) {
+        size_t value = count.load(std::memory_order_relaxed);
+        while (value != 0) {
+            if (count.compare_exchange_weak(value, value + 1, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// For pointers that never leave one thread: plain integer arithmetic.
+struct NonAtomicRefCount {
+    using Count = size_t;
+
+    static void Increment(Count& count) {
+        ++count;
+    }
+
+    static size_t Decrement(Count& count) {
+        return --count;
+    }
+
+    static size_t Load(const Count& count) {
+        return count;
+    }
+
+    static bool IncrementIfNotZero(Count& count) {
+        if (count == 0) {
+            return false;
+        }
+        ++count;
+        return true;
+    }
+};
+
+template<class T, class Policy = AtomicRefCount>
 class WeakPtr;
 
+template<class T, class Policy = AtomicRefCount>
+class EnableSharedFromThis;
+
+// Whether T derives from EnableSharedFromThis under any policy.
+template<class U, class Policy>
+std::true_type DetectSharedFromThis(const EnableSharedFromThis<U, Policy>*);
+
+std::false_type DetectSharedFromThis(...);
+
+template<class T>
+using HasSharedFromThis = decltype(DetectSharedFromThis(std::declval<T*>()));
+
+// Control block. SharedPtr(T*) pairs it with a separately allocated object;
+// MakeShared/AllocateShared place the object right behind the counts, so one
+// allocation serves both. The object dies with the last SharedPtr, the block
+// with the last WeakPtr. All strong owners together hold one weak reference,
+// so each count is only ever checked by the thread that decremented it.
+template<class Policy = AtomicRefCount>
 struct Counter {
-    size_t cnt = 0;
-    size_t weak_cnt = 0;
+    typename Policy::Count cnt;
+    typename Policy::Count weak_cnt;
 
     Counter(size_t cnt, size_t weak_cnt) : cnt(cnt), weak_cnt(weak_cnt) {
     }
+
+    virtual ~Counter() = default;
+
+    virtual void DestroyObject() noexcept = 0;
+
+    virtual void DestroySelf() noexcept {
+        delete this;
+    }
+
+    void AddRef() {
+        Policy::Increment(cnt);
+    }
+
+    void AddWeakRef() {
+        Policy::Increment(weak_cnt);
+    }
+
+    bool TryAddRef() {
+        return Policy::IncrementIfNotZero(cnt);
+    }
+
+    void Release() {
+        if (Policy::Decrement(cnt) == 0) {
+            DestroyObject();
+            ReleaseWeak();
+        }
+    }
+
+    void ReleaseWeak() {
+        if (Policy::Decrement(weak_cnt) == 0) {
+            DestroySelf();
+        }
+    }
+
+    size_t UseCount() const {
+        return Policy::Load(cnt);
+    }
 };
 
-template<class T>
+// Block of SharedPtr(T*). It has the same small size for every T, so it
+// comes from ControlBlockPool instead of the global allocator.
+template<class T, class Policy = AtomicRefCount>
+struct PointerCounter : Counter<Policy> {
+    T* ptr;
+
+    explicit PointerCounter(T* ptr) : Counter<Policy>(1, 1), ptr(ptr) {
+    }
+
+    void DestroyObject() noexcept override {
+        delete ptr;
+    }
+
+    static void* operator new(size_t size) {
+        void* block = size > ControlBlockPool::kBlockSize ? ::operator new(size) : ControlBlockPool::Allocate();
+        CONTAINERS_RECORD_ALLOCATION(kSharedPtr, size);
+        return block;
+    }
+
+    static void operator delete(void* ptr, size_t size) noexcept {
+        CONTAINERS_RECORD_DEALLOCATION(kSharedPtr, size);
+        if (size > ControlBlockPool::kBlockSize) {
+            ::operator delete(ptr);
+            return;
+        }
+        ControlBlockPool::Deallocate(ptr);
+    }
+};
+
+// Block of SharedPtr(T*, Deleter, Alloc): the object is released through a
+// copy of the deleter, and the block itself through alloc (rebound to the
+// block type). Neither type shows up in SharedPtr's own type.
+template<class T, class Deleter, class Alloc, class Policy = AtomicRefCount>
+struct DeleterCounter : Counter<Policy> {
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<DeleterCounter>;
+
+    T* ptr;
+    Deleter deleter;
+    BlockAlloc alloc;
+
+    DeleterCounter(T* ptr, const Deleter& deleter, const Alloc& alloc)
+            : Counter<Policy>(1, 1), ptr(ptr), deleter(deleter), alloc(alloc) {
+    }
+
+    void DestroyObject() noexcept override {
+        deleter(ptr);
+    }
+
+    void DestroySelf() noexcept override {
+        CONTAINERS_RECORD_DEALLOCATION(kSharedPtr, sizeof(DeleterCounter));
+        BlockAlloc block_alloc(alloc);
+        this->~DeleterCounter();
+        std::allocator_traits<BlockAlloc>::deallocate(block_alloc, this, 1);
+    }
+};
+
+template<class T, class Policy = AtomicRefCount>
+struct InplaceCounter : Counter<Policy> {
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    template<class... Args>
+    explicit InplaceCounter(Args&&... args) : Counter<Policy>(1, 1) {
+        new (storage) T(std::forward<Args>(args)...);
+    }
+
+    T* Get() {
+        return std::launder(reinterpret_cast<T*>(storage));
+    }
+
+    void DestroyObject() noexcept override {
+        Get()->~T();
+    }
+
+    void DestroySelf() noexcept override {
+        CONTAINERS_RECORD_DEALLOCATION(kSharedPtr, sizeof(InplaceCounter));
+        delete this;
+    }
+};
+
+template<class T, class Alloc, class Policy = AtomicRefCount>
+struct AllocatedInplaceCounter : InplaceCounter<T, Policy> {
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<AllocatedInplaceCounter>;
+
+    BlockAlloc alloc;
+
+    template<class... Args>
+    explicit AllocatedInplaceCounter(const Alloc& alloc, Args&&... args)
+            : InplaceCounter<T, Policy>(std::forward<Args>(args)...), alloc(alloc) {
+    }
+
+    void DestroySelf() noexcept override {
+        CONTAINERS_RECORD_DEALLOCATION(kSharedPtr, sizeof(AllocatedInplaceCounter));
+        BlockAlloc block_alloc(alloc);
+        this->~AllocatedInplaceCounter();
+        std::allocator_traits<BlockAlloc>::deallocate(block_alloc, this, 1);
+    }
+};
+
+// Policy selects atomic (default) or non-atomic reference counting; the
+// latter is only safe while every copy stays on one thread.
+template<class T, class Policy = AtomicRefCount>
 class SharedPtr {
     T* ptr_ = nullptr;
-    Counter* counters_ = nullptr;
+    Counter<Policy>* counters_ = nullptr;
+
+    // Adopts a block whose count already accounts for this pointer.
+    SharedPtr(Counter<Policy>* counters, T* ptr) : ptr_(ptr), counters_(counters) {
+    }
+
+    // Called once a new block owns ptr_: if T derives from
+    // EnableSharedFromThis, points its weak reference at that block.
+    template<class U>
+    void BindSharedFromThis(const EnableSharedFromThis<U, Policy>* base) {
+        if (base != nullptr && base->weak_this_.Expired()) {
+            base->weak_this_ = SharedPtr<U, Policy>(*this, const_cast<U*>(static_cast<const U*>(ptr_)));
+        }
+    }
+
+    // Only reached when T has no EnableSharedFromThis base with this Policy.
+    void BindSharedFromThis(...) {
+        static_assert(!HasSharedFromThis<T>::value,
+                      "T derives from EnableSharedFromThis with another refcount policy than this SharedPtr");
+    }
 
 public:
     SharedPtr() = default;
 
-    SharedPtr(T* ptr) : ptr_(ptr), counters_(ptr ? new Counter{1, 0} : nullptr) {
+    SharedPtr(T* ptr) : ptr_(ptr), counters_(nullptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        try {
+            counters_ = new PointerCounter<T, Policy>(ptr);
+        } catch (...) {
+            delete ptr;
+            throw;
+        }
+        BindSharedFromThis(ptr_);
+    }
+
+    // deleter(ptr) runs instead of delete ptr, even if ptr is null. If the
+    // block cannot be allocated, ptr is released through deleter right away.
+    template<class Deleter>
+    SharedPtr(T* ptr, Deleter deleter) : SharedPtr(ptr, std::move(deleter), std::allocator<T>()) {
+    }
+
+    template<class Deleter, class Alloc>
+    SharedPtr(T* ptr, Deleter deleter, const Alloc& alloc) : ptr_(ptr), counters_(nullptr) {
+        using Block = DeleterCounter<T, Deleter, Alloc, Policy>;
+        typename Block::BlockAlloc block_alloc(alloc);
+
+        Block* block = nullptr;
+        try {
+            block = std::allocator_traits<typename Block::BlockAlloc>::allocate(block_alloc, 1);
+        } catch (...) {
+            deleter(ptr);
+            throw;
+        }
+
+        try {
+            new (block) Block(ptr, deleter, alloc);
+        } catch (...) {
+            std::allocator_traits<typename Block::BlockAlloc>::deallocate(block_alloc, block, 1);
+            deleter(ptr);
+            throw;
+        }
+        CONTAINERS_RECORD_ALLOCATION(kSharedPtr, sizeof(Block));
+        counters_ = block;
+        BindSharedFromThis(ptr_);
     }
 
     SharedPtr(const SharedPtr& other) : ptr_(other.ptr_), counters_(other.counters_) {
-        if (ptr_ != nullptr) {
-            ++counters_->cnt;
+        if (counters_ != nullptr) {
+            counters_->AddRef();
         }
     }
 
@@ -56,13 +334,34 @@ public:
         other.counters_ = nullptr;
     }
 
-    SharedPtr(const WeakPtr<T>& weak_ptr) : ptr_(weak_ptr.ptr_), counters_(weak_ptr.counters_) {
-        if (weak_ptr.Expired()) {
-            throw BadWeakPtr{};
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    SharedPtr(const SharedPtr<U, Policy>& other) : SharedPtr(other, other.Get()) {
+    }
+
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    SharedPtr(SharedPtr<U, Policy>&& other) noexcept : SharedPtr(std::move(other), other.Get()) {
+    }
+
+    // Aliasing: shares other's block (and lifetime) but points to ptr,
+    // typically a member or base of the object other owns.
+    template<class U>
+    SharedPtr(const SharedPtr<U, Policy>& other, T* ptr) : ptr_(ptr), counters_(other.counters_) {
+        if (counters_ != nullptr) {
+            counters_->AddRef();
         }
+    }
 
-        if (ptr_) {
-            ++counters_->cnt;
+    template<class U>
+    SharedPtr(SharedPtr<U, Policy>&& other, T* ptr) noexcept : ptr_(ptr), counters_(other.counters_) {
+        other.ptr_ = nullptr;
+        other.counters_ = nullptr;
+    }
+
+    SharedPtr(const WeakPtr<T, Policy>& weak_ptr) : ptr_(weak_ptr.ptr_), counters_(weak_ptr.counters_) {
+        if (counters_ == nullptr || !counters_->TryAddRef()) {
+            ptr_ = nullptr;
+            counters_ = nullptr;
+            throw BadWeakPtr{};
         }
     }
 
@@ -88,22 +387,16 @@ public:
         return *this;
     }
 
-    ~SharedPtr<T>() {
+    ~SharedPtr() {
         if (counters_ == nullptr) {
             return;
         }
 
-        --counters_->cnt;
-        if (!counters_->cnt) {
-            delete ptr_;
-            if (!counters_->weak_cnt) {
-                delete counters_;
-            }
-        }
+        counters_->Release();
     }
 
     size_t UseCount() const {
-        return counters_ ? counters_->cnt : 0 ;
+        return counters_ ? counters_->UseCount() : 0;
     }
 
     T* Get() const {
@@ -129,31 +422,52 @@ public:
         Swap(tmp);
     }
 
+    template<class Deleter>
+    void Reset(T* ptr, Deleter deleter) {
+        SharedPtr tmp(ptr, std::move(deleter));
+        Swap(tmp);
+    }
+
+    template<class Deleter, class Alloc>
+    void Reset(T* ptr, Deleter deleter, const Alloc& alloc) {
+        SharedPtr tmp(ptr, std::move(deleter), alloc);
+        Swap(tmp);
+    }
+
     T* operator->() const {
         return ptr_;
     }
 
-    friend class WeakPtr<T>;
+    friend class WeakPtr<T, Policy>;
+
+    template<class U, class P>
+    friend class SharedPtr;
+
+    template<class U, class P, class... Args>
+    friend SharedPtr<U, P> MakeShared(Args&&... args);
+
+    template<class U, class P, class Alloc, class... Args>
+    friend SharedPtr<U, P> AllocateShared(const Alloc& alloc, Args&&... args);
 };
 
 
-template<class T>
+template<class T, class Policy>
 class WeakPtr {
     T* ptr_ = nullptr;
-    Counter* counters_ = nullptr;
+    Counter<Policy>* counters_ = nullptr;
 
 public:
     WeakPtr() = default;
 
-    WeakPtr(const SharedPtr<T>& shared_ptr) : ptr_(shared_ptr.Get()), counters_(shared_ptr.counters_) {
-        if (ptr_) {
-            ++counters_->weak_cnt;
+    WeakPtr(const SharedPtr<T, Policy>& shared_ptr) : ptr_(shared_ptr.Get()), counters_(shared_ptr.counters_) {
+        if (counters_) {
+            counters_->AddWeakRef();
         }
     }
 
     WeakPtr(const WeakPtr& other) : ptr_(other.ptr_), counters_(other.counters_) {
-        if (ptr_) {
-            ++counters_->weak_cnt;
+        if (counters_) {
+            counters_->AddWeakRef();
         }
     }
 
@@ -180,7 +494,7 @@ public:
             return *this;
         }
 
-        WeakPtr tmp(other);
+        WeakPtr tmp(std::move(other));
         Swap(tmp);
 
         return *this;
@@ -190,10 +504,7 @@ public:
         if (!counters_) {
             return;
         }
-        --counters_->weak_cnt;
-        if (counters_->cnt == 0 && counters_->weak_cnt == 0) {
-            delete counters_;
-        }
+        counters_->ReleaseWeak();
     }
 
     void Swap(WeakPtr& other) {
@@ -202,7 +513,7 @@ public:
     }
 
     size_t UseCount() const {
-        return counters_ ? counters_->cnt : 0;
+        return counters_ ? counters_->UseCount() : 0;
     }
 
     void Reset() {
@@ -214,12 +525,98 @@ public:
         return ptr_ == nullptr || UseCount() == 0;
     }
 
-    SharedPtr<T> Lock() const {
-        return Expired() ? nullptr : SharedPtr<T>(*this);
+    // The count is raised only if it is still non-zero (a CAS loop), so an
+    // object that is being destroyed concurrently can never be revived.
+    SharedPtr<T, Policy> Lock() const {
+        if (counters_ == nullptr || !counters_->TryAddRef()) {
+            return nullptr;
+        }
+        return SharedPtr<T, Policy>(counters_, ptr_);
     }
 
-    friend class SharedPtr<T>;
+    friend class SharedPtr<T, Policy>;
 };
 
-#endif //SHARED_PTR_SHARED_PTR_H
+// One allocation for the counts and the object.
+template<class T, class Policy = AtomicRefCount, class... Args>
+SharedPtr<T, Policy> MakeShared(Args&&... args) {
+    InplaceCounter<T, Policy>* block = new InplaceCounter<T, Policy>(std::forward<Args>(args)...);
+    CONTAINERS_RECORD_ALLOCATION(kSharedPtr, sizeof(*block));
+    SharedPtr<T, Policy> res(block, block->Get());
+    res.BindSharedFromThis(res.ptr_);
+    return res;
+}
+
+// Like MakeShared, with the block allocated through alloc (rebound to the
+// block type). A copy of the allocator lives in the block to free it. With
+// PolymorphicAllocator this puts the block into any MemoryResource.
+template<class T, class Policy = AtomicRefCount, class Alloc, class... Args>
+SharedPtr<T, Policy> AllocateShared(const Alloc& alloc, Args&&... args) {
+    using Block = AllocatedInplaceCounter<T, Alloc, Policy>;
+    typename Block::BlockAlloc block_alloc(alloc);
+
+    Block* block = std::allocator_traits<typename Block::BlockAlloc>::allocate(block_alloc, 1);
+    try {
+        new (block) Block(alloc, std::forward<Args>(args)...);
+    } catch (...) {
+        std::allocator_traits<typename Block::BlockAlloc>::deallocate(block_alloc, block, 1);
+        throw;
+    }
+    CONTAINERS_RECORD_ALLOCATION(kSharedPtr, sizeof(Block));
+    SharedPtr<T, Policy> res(block, block->Get());
+    res.BindSharedFromThis(res.ptr_);
+    return res;
+}
+
+template<class T, class U, class Policy>
+SharedPtr<T, Policy> StaticPointerCast(const SharedPtr<U, Policy>& other) {
+    return SharedPtr<T, Policy>(other, static_cast<T*>(other.Get()));
+}
+
+// Empty if the cast fails.
+template<class T, class U, class Policy>
+SharedPtr<T, Policy> DynamicPointerCast(const SharedPtr<U, Policy>& other) {
+    T* ptr = dynamic_cast<T*>(other.Get());
+    return ptr != nullptr ? SharedPtr<T, Policy>(other, ptr) : SharedPtr<T, Policy>();
+}
+
+// Base for objects that need a SharedPtr to themselves (async callbacks).
+// Any SharedPtr that takes ownership of the object with a new block (from
+// T*, MakeShared, AllocateShared) records that block here, so
+// SharedFromThis() joins it instead of creating a second one. Calling it on
+// an object that no SharedPtr owns throws BadWeakPtr.
+template<class T, class Policy>
+class EnableSharedFromThis {
+    mutable WeakPtr<T, Policy> weak_this_;
+
+    template<class U, class P>
+    friend class SharedPtr;
+
+protected:
+    EnableSharedFromThis() = default;
+
+    // A copy is a different object, owned (or not) on its own.
+    EnableSharedFromThis(const EnableSharedFromThis&) {
+    }
+
+    EnableSharedFromThis& operator=(const EnableSharedFromThis&) {
+        return *this;
+    }
+
+    ~EnableSharedFromThis() = default;
 
+public:
+    SharedPtr<T, Policy> SharedFromThis() {
+        return SharedPtr<T, Policy>(weak_this_);
+    }
+
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        return SharedPtr<const T, Policy>(SharedPtr<T, Policy>(weak_this_));
+    }
+
+    WeakPtr<T, Policy> WeakFromThis() const {
+        return weak_this_;
+    }
+};
+
+#endif //SHARED_PTR_SHARED_PTR_H
@@ -1,12 +1,28 @@
 #include "string.h"
 
-String::String(): size_(0), capacity_(1) {
-    buffer_ = new char[1];
+char* String::AllocateBuffer(size_t capacity) {
+    CONTAINERS_RECORD_ALLOCATION(kString, capacity + 1);
+    return static_cast<char*>(resource_->Allocate(capacity + 1, alignof(char)));
+}
+
+void String::FreeBuffer() {
+    if (buffer_ == nullptr) {
+        return;
+    }
+    CONTAINERS_RECORD_DEALLOCATION(kString, capacity_ + 1);
+    resource_->Deallocate(buffer_, capacity_ + 1, alignof(char));
+}
+
+String::String(): String(DefaultResource()) {
+}
+
+String::String(MemoryResource* resource): size_(0), capacity_(0), resource_(resource) {
+    buffer_ = AllocateBuffer(0);
     buffer_[0] = '\0';
 }
 
-String::String(size_t size, char symbol): size_(size), capacity_(size) {
-    buffer_ = new char[Size() + 1];
+String::String(size_t size, char symbol): size_(size), capacity_(size), resource_(DefaultResource()) {
+    buffer_ = AllocateBuffer(Size());
 
     for (int i = 0; i < Size(); ++i) {
         buffer_[i] = symbol;
@@ -23,10 +39,12 @@ size_t Size(const char* str) {
     return str_size;
 }
 
-String::String(const char* str) {
-    buffer_ = new char[Size() + 1];
+String::String(const char* str): String(str, DefaultResource()) {
+}
 
+String::String(const char* str, MemoryResource* resource): resource_(resource) {
     size_t str_size = ::Size(str);
+    buffer_ = AllocateBuffer(str_size);
 
     for (size_t i = 0; i < str_size; ++i) {
         buffer_[i] = str[i];
@@ -37,8 +55,8 @@ String::String(const char* str) {
     buffer_[Size()] = '\0';
 }
 
-String::String(const char* str, const size_t size): size_(size), capacity_(size) {
-    buffer_ = new char[size + 1];
+String::String(const char* str, const size_t size): size_(size), capacity_(size), resource_(DefaultResource()) {
+    buffer_ = AllocateBuffer(size);
 
     for (size_t i = 0; i < size; ++i) {
         buffer_[i] = str[i];
@@ -47,19 +65,31 @@ String::String(const char* str, const size_t size): size_(size), capacity_(size)
     buffer_[size] = '\0';
 }
 
-String::String(const String& other): size_(other.size_), capacity_(other.capacity_){
-    buffer_ = new char[Size() + 1];
+String::String(const String& other): String(other, DefaultResource()) {
+}
+
+String::String(const String& other, MemoryResource* resource)
+        : size_(other.size_), capacity_(other.size_), resource_(resource) {
+    buffer_ = AllocateBuffer(Size());
+    const char* str = other.CStr();
     for (int i = 0; i < Size() + 1; ++i) {
-        buffer_[i] = other.buffer_[i];
+        buffer_[i] = str[i];
     }
 }
 
+String::String(String&& other) noexcept
+        : buffer_(other.buffer_), size_(other.size_), capacity_(other.capacity_), resource_(other.resource_) {
+    other.buffer_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+}
+
 void String::Resize(){
-    Resize(kIncreaseFactor * size_);
+    Resize(size_ == 0 ? 1 : kIncreaseFactor * size_);
 }
 
 void String::Resize(size_t new_size, char fill) {
-    char* new_str = new char[new_size + 1];
+    char* new_str = AllocateBuffer(new_size);
 
     for(int i = 0; i < Size() && i < new_size; ++i) {
         new_str[i] = buffer_[i];
@@ -70,8 +100,9 @@ void String::Resize(size_t new_size, char fill) {
     }
 
     new_str[new_size] = '\0';
+    CONTAINERS_RECORD_REALLOCATION(kString, Size() < new_size ? Size() : new_size, new_size + 1);
 
-    delete[] buffer_;
+    FreeBuffer();
 
     capacity_ = new_size;
     buffer_ = new_str;
@@ -83,15 +114,18 @@ String& String::operator=(const String& other) {
         return *this;
     }
 
-    if (Size() < other.size_) {
+    if (buffer_ == nullptr || Capacity() < other.size_) {
         Resize(other.size_);
     }
 
+    const char* str = other.CStr();
     for (int i = 0; i < other.Size() + 1; ++i) {
-        buffer_[i] = other.buffer_[i];
+        buffer_[i] = str[i];
     }
 
     size_ = other.Size();
+    CONTAINERS_RECORD_SIZE(kString, Size());
+    return *this;
 }
 
 size_t String::Size() const {
@@ -106,6 +140,10 @@ size_t String::Capacity() const {
     return capacity_;
 }
 
+MemoryResource* String::Resource() const {
+    return resource_;
+}
+
 bool String::Empty() const {
     return Size() == 0;
 }
@@ -118,7 +156,9 @@ void String::Reserve(size_t new_capacity) {
 
 void String::Clear() {
     size_ = 0;
-    buffer_[0] = '\0';
+    if (buffer_ != nullptr) {
+        buffer_[0] = '\0';
+    }
 }
 
 char& String::Back() {
@@ -138,7 +178,7 @@ const char& String::Front() const {
 }
 
 String::~String() {
-    delete[] buffer_;
+    FreeBuffer();
 }
 
 char& String::operator[](size_t idx){
@@ -158,6 +198,7 @@ void String::PushBack(char symbol) {
 
     buffer_[Size() - 1] = symbol;
     buffer_[Size()] = '\0';
+    CONTAINERS_RECORD_SIZE(kString, Size());
 
 }
 
@@ -169,11 +210,11 @@ void String::PopBack() {
 }
 
 const char* String::CStr() const {
-    return buffer_;
+    return buffer_ == nullptr ? "" : buffer_;
 }
 
 const char* String::Data() const {
-    return buffer_;
+    return CStr();
 }
 
 String& String::operator+=(const String& other) {
@@ -181,8 +222,6 @@ String& String::operator+=(const String& other) {
         PushBack(other.buffer_[i]);
     }
 
-    buffer_[Size()] = '\0';
-
     return *this;
 }
 
@@ -1,28 +1,43 @@
 #ifndef STRING_H
 #define STRING_H
 
+#include "instrumentation.h"
+#include "memory_resource.h"
+
 #include <cstdio>
 #include <iostream>
 
+// The buffer always holds capacity_ + 1 chars (room for the '\0') and comes
+// from resource_, DefaultResource() unless given. A moved-from String has no
+// buffer: it is empty and allocates on the next growth.
 class String {
     char* buffer_;
     size_t size_;
     size_t capacity_;
+    MemoryResource* resource_;
 
     const static size_t kIncreaseFactor = 2;
 
+    char* AllocateBuffer(size_t capacity);
+    void FreeBuffer();
+
 public:
     String();
+    explicit String(MemoryResource* resource);
     explicit String(const char* str);
+    String(const char* str, MemoryResource* resource);
     explicit String(size_t size, char symbol = 'a');
     String(const char* str, size_t n);
     String(const String& other);
+    String(const String& other, MemoryResource* resource);
+    String(String&& other) noexcept;
 
     ~String();
 
     size_t Size() const;
     size_t Length() const;
     size_t Capacity() const;
+    MemoryResource* Resource() const;
 
     bool Empty() const;
 
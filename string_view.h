@@ -0,0 +1,53 @@
+#ifndef STRING_VIEW_H
+#define STRING_VIEW_H
+
+#include "string.h"
+
+#include <cstddef>
+#include <cstring>
+
+// Non-owning view of characters: a pointer and a length. The characters
+// must outlive the view; they need not be '\0'-terminated.
+class StringView {
+    const char* data_;
+    size_t size_;
+
+public:
+    StringView() : data_(""), size_(0) {
+    }
+
+    StringView(const char* str) : data_(str), size_(std::strlen(str)) {
+    }
+
+    StringView(const char* str, size_t size) : data_(str), size_(size) {
+    }
+
+    StringView(const String& str) : data_(str.Data()), size_(str.Size()) {
+    }
+
+    const char* Data() const {
+        return data_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    const char& operator[](size_t idx) const {
+        return data_[idx];
+    }
+};
+
+inline bool operator==(StringView lhs, StringView rhs) {
+    return lhs.Size() == rhs.Size() && (lhs.Size() == 0 || std::memcmp(lhs.Data(), rhs.Data(), lhs.Size()) == 0);
+}
+
+inline bool operator!=(StringView lhs, StringView rhs) {
+    return !(lhs == rhs);
+}
+
+#endif // STRING_VIEW_H
@@ -0,0 +1,238 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include "function.h"
+#include "mpmc_queue.h"
+#include "work_stealing_deque.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+class TaskScheduler;
+
+// Fork/join frame: Spawn() forks a child task, Sync() joins all of them.
+// A thread blocked in Sync() keeps executing other tasks meanwhile, so
+// recursive divide-and-conquer never parks a worker.
+class TaskGroup {
+    TaskScheduler& scheduler_;
+    std::atomic<size_t> pending_;
+
+public:
+    explicit TaskGroup(TaskScheduler& scheduler) : scheduler_(scheduler), pending_(0) {
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup() {
+        Sync();
+    }
+
+    void Spawn(Function<void()> fn);
+    void Sync();
+};
+
+// Work-stealing scheduler: one Chase-Lev deque per worker. Workers run their
+// own newest tasks first (LIFO, cache-warm) and steal the oldest task of a
+// random victim when idle. Tasks spawned from outside the pool go through a
+// shared injection queue.
+class TaskScheduler {
+    struct Task {
+        Function<void()> fn;
+        std::atomic<size_t>* pending;
+    };
+
+    struct Worker {
+        WorkStealingDeque<Task*> deque;
+        std::thread thread;
+        uint64_t rng = 0;
+    };
+
+    const static size_t kInjectionCapacity = 4096;
+    const static int kIdleSpins = 64;
+
+    Worker* workers_;
+    size_t workers_count_;
+    MPMCQueue<Task*> injected_;
+
+    std::atomic<bool> stop_;
+    std::atomic<size_t> sleeping_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+
+    static TaskScheduler*& CurrentScheduler() {
+        static thread_local TaskScheduler* scheduler = nullptr;
+        return scheduler;
+    }
+
+    static Worker*& CurrentWorkerSlot() {
+        static thread_local Worker* worker = nullptr;
+        return worker;
+    }
+
+    Worker* CurrentWorker() {
+        return CurrentScheduler() == this ? CurrentWorkerSlot() : nullptr;
+    }
+
+    static uint64_t NextRandom(uint64_t& state) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    bool FindTask(Worker* self, Task*& task) {
+        if (self != nullptr && self->deque.Pop(task)) {
+            return true;
+        }
+
+        uint64_t local_rng = reinterpret_cast<uintptr_t>(&task) | 1;
+        uint64_t& rng = self != nullptr ? self->rng : local_rng;
+        for (size_t attempt = 0; attempt < workers_count_; ++attempt) {
+            Worker& victim = workers_[NextRandom(rng) % workers_count_];
+            if (&victim != self && victim.deque.Steal(task)) {
+                return true;
+            }
+        }
+
+        return injected_.TryPop(task);
+    }
+
+    static void Execute(Task* task) {
+        task->fn();
+        task->pending->fetch_sub(1, std::memory_order_release);
+        delete task;
+    }
+
+    void WakeOne() {
+        if (sleeping_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+
+    void WorkerLoop(Worker* self) {
+        CurrentScheduler() = this;
+        CurrentWorkerSlot() = self;
+
+        Task* task = nullptr;
+        int idle = 0;
+        while (!stop_.load(std::memory_order_acquire)) {
+            if (FindTask(self, task)) {
+                Execute(task);
+                idle = 0;
+                continue;
+            }
+
+            if (++idle < kIdleSpins) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // The timeout bounds the cost of a wake-up lost to a push into
+            // some worker's private deque.
+            sleeping_.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!stop_.load(std::memory_order_relaxed)) {
+                    wake_.wait_for(lock, std::chrono::milliseconds(1));
+                }
+            }
+            sleeping_.fetch_sub(1, std::memory_order_relaxed);
+            idle = 0;
+        }
+
+        CurrentScheduler() = nullptr;
+        CurrentWorkerSlot() = nullptr;
+    }
+
+public:
+    explicit TaskScheduler(size_t workers_count = std::thread::hardware_concurrency())
+            : workers_(nullptr),
+              workers_count_(workers_count == 0 ? 1 : workers_count),
+              injected_(kInjectionCapacity),
+              stop_(false),
+              sleeping_(0) {
+        workers_ = new Worker[workers_count_];
+        for (size_t i = 0; i < workers_count_; ++i) {
+            workers_[i].rng = 0x9E3779B97F4A7C15ull * (i + 1);
+        }
+        for (size_t i = 0; i < workers_count_; ++i) {
+            workers_[i].thread = std::thread(&TaskScheduler::WorkerLoop, this, &workers_[i]);
+        }
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Every TaskGroup must be synced before the scheduler goes away.
+    ~TaskScheduler() {
+        stop_.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_all();
+        }
+
+        for (size_t i = 0; i < workers_count_; ++i) {
+            workers_[i].thread.join();
+        }
+
+        delete[] workers_;
+    }
+
+    size_t WorkersCount() const {
+        return workers_count_;
+    }
+
+    void Spawn(Function<void()> fn, std::atomic<size_t>& pending) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        Task* task = new Task{std::move(fn), &pending};
+
+        Worker* self = CurrentWorker();
+        if (self != nullptr) {
+            self->deque.Push(task);
+        } else {
+            injected_.Push(task);
+        }
+
+        WakeOne();
+    }
+
+    void Sync(std::atomic<size_t>& pending) {
+        Worker* self = CurrentWorker();
+        Task* task = nullptr;
+
+        while (pending.load(std::memory_order_acquire) != 0) {
+            if (FindTask(self, task)) {
+                Execute(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Runs fn on the pool and waits for it together with everything it spawned.
+    void Run(Function<void()> fn) {
+        TaskGroup group(*this);
+        group.Spawn(std::move(fn));
+        group.Sync();
+    }
+};
+
+inline void TaskGroup::Spawn(Function<void()> fn) {
+    scheduler_.Spawn(std::move(fn), pending_);
+}
+
+inline void TaskGroup::Sync() {
+    scheduler_.Sync(pending_);
+}
+
+#endif // TASK_SCHEDULER_H
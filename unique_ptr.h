@@ -1,86 +1,303 @@
 #ifndef UNIQUE_PTR_UNIQUE_PTR_H
 #define UNIQUE_PTR_UNIQUE_PTR_H
 
+#include <cstddef>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 template<class T>
-class UniquePtr {
+struct DefaultDelete {
+    DefaultDelete() = default;
+
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    DefaultDelete(const DefaultDelete<U>&) {
+    }
+
+    void operator()(T* ptr) const {
+        delete ptr;
+    }
+};
+
+template<class T>
+struct DefaultDelete<T[]> {
+    void operator()(T* ptr) const {
+        delete[] ptr;
+    }
+};
+
+// For objects placed in an arena whose memory is released in bulk: runs the
+// destructor and frees nothing, so for trivially destructible T it compiles
+// to nothing at all.
+template<class T>
+struct ArenaDeleter {
+    void operator()(T* ptr) const {
+        ptr->~T();
+    }
+};
+
+// Pointer plus deleter. Empty deleters are inherited from (empty-base
+// optimization), so UniquePtr<T, Stateless> is as wide as a raw pointer.
+template<class T, class Deleter, bool = std::is_empty<Deleter>::value && !std::is_final<Deleter>::value>
+class PointerWithDeleter : private Deleter {
+    T* ptr_;
+
+public:
+    PointerWithDeleter(T* ptr, const Deleter& deleter) : Deleter(deleter), ptr_(ptr) {
+    }
+
+    PointerWithDeleter(T* ptr, Deleter&& deleter) : Deleter(std::move(deleter)), ptr_(ptr) {
+    }
+
+    T*& Pointer() {
+        return ptr_;
+    }
+
+    T* Pointer() const {
+        return ptr_;
+    }
+
+    Deleter& GetDeleter() {
+        return *this;
+    }
+
+    const Deleter& GetDeleter() const {
+        return *this;
+    }
+};
+
+template<class T, class Deleter>
+class PointerWithDeleter<T, Deleter, false> {
     T* ptr_;
+    Deleter deleter_;
+
+public:
+    PointerWithDeleter(T* ptr, const Deleter& deleter) : ptr_(ptr), deleter_(deleter) {
+    }
+
+    PointerWithDeleter(T* ptr, Deleter&& deleter) : ptr_(ptr), deleter_(std::move(deleter)) {
+    }
+
+    T*& Pointer() {
+        return ptr_;
+    }
+
+    T* Pointer() const {
+        return ptr_;
+    }
+
+    Deleter& GetDeleter() {
+        return deleter_;
+    }
+
+    const Deleter& GetDeleter() const {
+        return deleter_;
+    }
+};
+
+template<class T, class Deleter = DefaultDelete<T>>
+class UniquePtr {
+    PointerWithDeleter<T, Deleter> storage_;
+
+    template<class U, class E>
+    friend class UniquePtr;
 
 public:
-    UniquePtr() : ptr_(nullptr) {
+    UniquePtr() : storage_(nullptr, Deleter()) {
+    }
+
+    UniquePtr(std::nullptr_t) : UniquePtr() {
     }
 
-    explicit UniquePtr(T* ptr) : ptr_(ptr){
+    explicit UniquePtr(T* ptr) : storage_(ptr, Deleter()) {
+    }
+
+    UniquePtr(T* ptr, const Deleter& deleter) : storage_(ptr, deleter) {
+    }
+
+    UniquePtr(T* ptr, Deleter&& deleter) : storage_(ptr, std::move(deleter)) {
     }
 
     UniquePtr(const UniquePtr&) = delete;
     UniquePtr& operator=(const UniquePtr&) = delete;
-    UniquePtr(UniquePtr&& other) noexcept : ptr_(other.ptr_) {
-        other.ptr_ = nullptr;
+
+    UniquePtr(UniquePtr&& other) noexcept : storage_(other.Release(), std::move(other.GetDeleter())) {
+    }
+
+    template<class U, class E, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    UniquePtr(UniquePtr<U, E>&& other) noexcept : storage_(other.Release(), std::move(other.GetDeleter())) {
     }
 
     UniquePtr& operator=(T* other_ptr) {
-        if (!(*this == other_ptr)) {
+        if (Get() != other_ptr) {
             Reset(other_ptr);
         }
         return *this;
     }
 
     UniquePtr& operator=(UniquePtr&& other) noexcept {
-        delete ptr_;
-        ptr_ = other.ptr_;
-        other.ptr_ = nullptr;
+        Reset(other.Release());
+        GetDeleter() = std::move(other.GetDeleter());
+        return *this;
+    }
+
+    template<class U, class E, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    UniquePtr& operator=(UniquePtr<U, E>&& other) noexcept {
+        Reset(other.Release());
+        GetDeleter() = std::move(other.GetDeleter());
         return *this;
     }
 
-    void Swap(UniquePtr<T>& other) {
-        std::swap(ptr_, other.ptr_);
+    void Swap(UniquePtr& other) {
+        std::swap(storage_, other.storage_);
     }
 
     T* Get() const {
-        return ptr_;
+        return storage_.Pointer();
+    }
+
+    Deleter& GetDeleter() {
+        return storage_.GetDeleter();
+    }
+
+    const Deleter& GetDeleter() const {
+        return storage_.GetDeleter();
     }
 
     T& operator*() const {
-        return *ptr_;
+        return *Get();
     }
 
-    const T* operator->() const {
-        return ptr_;
+    T* operator->() const {
+        return Get();
     }
 
     explicit operator bool() const {
-        return ptr_ != nullptr;
+        return Get() != nullptr;
     }
 
     T* Release() {
-        T* old_ptr = ptr_;
-        ptr_ = nullptr;
+        T* old_ptr = Get();
+        storage_.Pointer() = nullptr;
         return old_ptr;
     }
 
     void Reset(T* ptr = nullptr) {
-        delete ptr_;
-        ptr_ = ptr;
+        T* old_ptr = Get();
+        storage_.Pointer() = ptr;
+        if (old_ptr != nullptr) {
+            GetDeleter()(old_ptr);
+        }
     }
 
     ~UniquePtr() {
-        delete ptr_;
+        Reset();
     }
 };
 
-template<class T>
-bool operator==(const UniquePtr<T>& lhs, const UniquePtr<T>& rhs) {
+// Array form: delete[] by default, indexing instead of * and ->.
+template<class T, class Deleter>
+class UniquePtr<T[], Deleter> {
+    PointerWithDeleter<T, Deleter> storage_;
+
+public:
+    UniquePtr() : storage_(nullptr, Deleter()) {
+    }
+
+    UniquePtr(std::nullptr_t) : UniquePtr() {
+    }
+
+    explicit UniquePtr(T* ptr) : storage_(ptr, Deleter()) {
+    }
+
+    UniquePtr(T* ptr, const Deleter& deleter) : storage_(ptr, deleter) {
+    }
+
+    UniquePtr(T* ptr, Deleter&& deleter) : storage_(ptr, std::move(deleter)) {
+    }
+
+    UniquePtr(const UniquePtr&) = delete;
+    UniquePtr& operator=(const UniquePtr&) = delete;
+
+    UniquePtr(UniquePtr&& other) noexcept : storage_(other.Release(), std::move(other.GetDeleter())) {
+    }
+
+    UniquePtr& operator=(UniquePtr&& other) noexcept {
+        Reset(other.Release());
+        GetDeleter() = std::move(other.GetDeleter());
+        return *this;
+    }
+
+    void Swap(UniquePtr& other) {
+        std::swap(storage_, other.storage_);
+    }
+
+    T* Get() const {
+        return storage_.Pointer();
+    }
+
+    Deleter& GetDeleter() {
+        return storage_.GetDeleter();
+    }
+
+    const Deleter& GetDeleter() const {
+        return storage_.GetDeleter();
+    }
+
+    T& operator[](size_t idx) const {
+        return Get()[idx];
+    }
+
+    explicit operator bool() const {
+        return Get() != nullptr;
+    }
+
+    T* Release() {
+        T* old_ptr = Get();
+        storage_.Pointer() = nullptr;
+        return old_ptr;
+    }
+
+    void Reset(T* ptr = nullptr) {
+        T* old_ptr = Get();
+        storage_.Pointer() = ptr;
+        if (old_ptr != nullptr) {
+            GetDeleter()(old_ptr);
+        }
+    }
+
+    ~UniquePtr() {
+        Reset();
+    }
+};
+
+template<class T, class D1, class U, class D2>
+bool operator==(const UniquePtr<T, D1>& lhs, const UniquePtr<U, D2>& rhs) {
     return lhs.Get() == rhs.Get();
 }
 
-template<class T>
-bool operator !=(const UniquePtr<T>& lhs, const UniquePtr<T>& rhs) {
+template<class T, class D1, class U, class D2>
+bool operator !=(const UniquePtr<T, D1>& lhs, const UniquePtr<U, D2>& rhs) {
     return !(lhs == rhs);
 }
 
+template<class T, class... Args>
+std::enable_if_t<!std::is_array<T>::value, UniquePtr<T>> MakeUnique(Args&&... args) {
+    return UniquePtr<T>(new T(std::forward<Args>(args)...));
+}
 
-#endif //UNIQUE_PTR_UNIQUE_PTR_H
+// MakeUnique<T[]>(size): size value-initialized elements.
+template<class T>
+std::enable_if_t<std::is_array<T>::value && std::extent<T>::value == 0, UniquePtr<T>> MakeUnique(size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]());
+}
 
+// Constructs T in memory from arena.Allocate(size, alignment); the memory goes
+// back when the arena is reset, the pointer only runs the destructor.
+template<class T, class Arena, class... Args>
+UniquePtr<T, ArenaDeleter<T>> MakeUniqueIn(Arena& arena, Args&&... args) {
+    void* memory = arena.Allocate(sizeof(T), alignof(T));
+    return UniquePtr<T, ArenaDeleter<T>>(new (memory) T(std::forward<Args>(args)...));
+}
 
+#endif //UNIQUE_PTR_UNIQUE_PTR_H
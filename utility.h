@@ -0,0 +1,19 @@
+#ifndef UTILITY_H
+#define UTILITY_H
+
+#include <cstddef>
+
+// Shared by Vector and CircularBuffer, which must be usable in one
+// translation unit.
+inline size_t Min(size_t a, size_t b) {
+    return (a < b) ? a : b;
+}
+
+template <class T>
+void Swap(T& a, T& b) {
+    T c = a;
+    a = b;
+    b = c;
+}
+
+#endif // UTILITY_H
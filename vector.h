@@ -1,25 +1,36 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include "instrumentation.h"
+#include "memory_resource.h"
+#include "utility.h"
+
 #include <cstdlib>
 
+// Memory comes from resource_, DefaultResource() unless given.
 template <class T>
 class Vector {
     T* buffer_;
     size_t size_;
     size_t capacity_;
+    MemoryResource* resource_;
 
     const static size_t kIncreaseFactor = 2;
 
+    T* AllocateBuffer(size_t capacity);
+    void FreeBuffer();
     void Fill(size_t start, size_t end, const T& value);
     size_t FindCorrectCapacity();
     void BufferReallocation(size_t new_capacity);
 
 public:
     Vector();
+    explicit Vector(MemoryResource* resource);
     explicit Vector(size_t size);
     Vector(size_t size, const T& value);
+    Vector(size_t size, const T& value, MemoryResource* resource);
     Vector(const Vector& other);
+    Vector(const Vector& other, MemoryResource* resource);
     Vector& operator=(const Vector& other);
     ~Vector();
 
@@ -46,15 +57,36 @@ public:
     size_t Size() const;
     size_t Capacity() const;
     const T* Data() const;
+    MemoryResource* Resource() const;
 };
 
 template <class T>
-Vector<T>::Vector() : size_(0), capacity_(0), buffer_(nullptr) {
+Vector<T>::Vector() : Vector(DefaultResource()) {
+}
+
+template <class T>
+Vector<T>::Vector(MemoryResource* resource) : buffer_(nullptr), size_(0), capacity_(0), resource_(resource) {
 }
 
 template <class T>
 Vector<T>::~Vector() {
-    delete[] buffer_;
+    FreeBuffer();
+}
+
+template <class T>
+T* Vector<T>::AllocateBuffer(size_t capacity) {
+    if (capacity > 0) {
+        CONTAINERS_RECORD_ALLOCATION(kVector, capacity * sizeof(T));
+    }
+    return NewArray<T>(resource_, capacity);
+}
+
+template <class T>
+void Vector<T>::FreeBuffer() {
+    if (buffer_ != nullptr) {
+        CONTAINERS_RECORD_DEALLOCATION(kVector, capacity_ * sizeof(T));
+    }
+    DeleteArray(resource_, buffer_, capacity_);
 }
 
 template <class T>
@@ -72,12 +104,23 @@ void Copy(const T* buff_from, size_t count, T* buff_to) {
 }
 
 template <class T>
-Vector<T>::Vector(size_t size) : size_(size), capacity_(size) {
-    buffer_ = new T[size_];
+Vector<T>::Vector(size_t size) : Vector(DefaultResource()) {
+    buffer_ = AllocateBuffer(size);
+    size_ = size;
+    capacity_ = size;
+    CONTAINERS_RECORD_SIZE(kVector, Size() * sizeof(T));
+}
+
+template <class T>
+Vector<T>::Vector(size_t size, const T& value) : Vector(size, value, DefaultResource()) {
 }
 
 template <class T>
-Vector<T>::Vector(size_t size, const T& value) : Vector(size) {
+Vector<T>::Vector(size_t size, const T& value, MemoryResource* resource) : Vector(resource) {
+    buffer_ = AllocateBuffer(size);
+    size_ = size;
+    capacity_ = size;
+    CONTAINERS_RECORD_SIZE(kVector, Size() * sizeof(T));
     Fill(0, Size(), value);
 }
 
@@ -88,20 +131,29 @@ Vector<T>& Vector<T>::operator=(const Vector& other) {
     }
 
     if (other.Size() > Capacity()) {
+        T* new_buff = AllocateBuffer(other.capacity_);
+        FreeBuffer();
+        buffer_ = new_buff;
         capacity_ = other.capacity_;
-        delete[] buffer_;
-        buffer_ = new T[Capacity()];
     }
 
     size_ = other.size_;
     Copy(other.buffer_, Size(), buffer_);
+    CONTAINERS_RECORD_SIZE(kVector, Size() * sizeof(T));
     return *this;
 }
 
 template <class T>
-Vector<T>::Vector(const Vector& other) : size_(other.Size()), capacity_(other.Capacity()) {
-    buffer_ = new T[other.Capacity()];
+Vector<T>::Vector(const Vector& other) : Vector(other, DefaultResource()) {
+}
+
+template <class T>
+Vector<T>::Vector(const Vector& other, MemoryResource* resource) : Vector(resource) {
+    buffer_ = AllocateBuffer(other.Capacity());
+    size_ = other.Size();
+    capacity_ = other.Capacity();
     Copy(other.buffer_, Size(), buffer_);
+    CONTAINERS_RECORD_SIZE(kVector, Size() * sizeof(T));
 }
 
 template <class T>
@@ -119,6 +171,11 @@ const T* Vector<T>::Data() const {
     return buffer_;
 }
 
+template <class T>
+MemoryResource* Vector<T>::Resource() const {
+    return resource_;
+}
+
 template <class T>
 bool Vector<T>::Empty() const {
     return Size() == 0;
@@ -153,22 +210,12 @@ const T& Vector<T>::Back() const {
     return buffer_[Size() - 1];
 }
 
-size_t Min(size_t a, size_t b) {
-    return (a < b) ? a : b;
-}
-
-template <class T>
-void Swap(T& a, T& b) {
-    T c = a;
-    a = b;
-    b = c;
-}
-
 template <class T>
 void Vector<T>::Swap(Vector<T>& other) {
     ::Swap(buffer_, other.buffer_);
     ::Swap(capacity_, other.capacity_);
     ::Swap(size_, other.size_);
+    ::Swap(resource_, other.resource_);
 }
 
 template <class T>
@@ -178,11 +225,12 @@ void Vector<T>::Clear() {
 
 template <class T>
 void Vector<T>::BufferReallocation(size_t new_capacity) {
-    T* new_buff = (new_capacity == 0) ? nullptr : new T[new_capacity];
+    T* new_buff = AllocateBuffer(new_capacity);
     size_ = Min(new_capacity, Size());
     Copy(buffer_, Size(), new_buff);
+    CONTAINERS_RECORD_REALLOCATION(kVector, Size() * sizeof(T), new_capacity * sizeof(T));
 
-    delete[] buffer_;
+    FreeBuffer();
     buffer_ = new_buff;
     capacity_ = new_capacity;
 }
@@ -200,6 +248,7 @@ void Vector<T>::PushBack(const T& value) {
 
     buffer_[Size()] = value;
     ++size_;
+    CONTAINERS_RECORD_SIZE(kVector, Size() * sizeof(T));
 }
 
 template <class T>
@@ -223,6 +272,7 @@ void Vector<T>::Resize(size_t new_size) {
     }
 
     size_ = new_size;
+    CONTAINERS_RECORD_SIZE(kVector, Size() * sizeof(T));
 }
 
 template <class T>
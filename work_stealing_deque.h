@@ -0,0 +1,157 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Chase-Lev work-stealing deque, with the memory orderings from Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP'13).
+// The owner thread pushes and pops at the bottom without locks; any other
+// thread may Steal() from the top, racing with a single CAS on top_.
+// Elements are copied through std::atomic<T>, so T has to be trivially
+// copyable (in practice: a pointer to a task).
+template <class T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque needs a trivially copyable T");
+
+    const static size_t kCacheLine = 64;
+    const static size_t kDefaultCapacity = 64;
+
+    struct Array {
+        int64_t capacity;
+        int64_t mask;
+        std::atomic<T>* buffer;
+        Array* previous;
+
+        Array(int64_t cap, Array* prev)
+                : capacity(cap), mask(cap - 1), buffer(new std::atomic<T>[cap]), previous(prev) {
+        }
+
+        ~Array() {
+            delete[] buffer;
+        }
+
+        T Get(int64_t idx) const {
+            return buffer[idx & mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t idx, T value) {
+            buffer[idx & mask].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(kCacheLine) std::atomic<int64_t> top_;
+    alignas(kCacheLine) std::atomic<int64_t> bottom_;
+    alignas(kCacheLine) std::atomic<Array*> array_;
+
+    // Thieves may still be reading an old array after a resize, so retired
+    // arrays stay chained behind the current one until the deque dies.
+    Array* Grow(Array* old, int64_t bottom, int64_t top) {
+        Array* bigger = new Array(old->capacity * 2, old);
+        for (int64_t i = top; i < bottom; ++i) {
+            bigger->Put(i, old->Get(i));
+        }
+
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+    explicit WorkStealingDeque(size_t capacity = kDefaultCapacity) : top_(0), bottom_(0), array_(nullptr) {
+        int64_t cap = 2;
+        while (cap < static_cast<int64_t>(capacity)) {
+            cap <<= 1;
+        }
+
+        array_.store(new Array(cap, nullptr), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    ~WorkStealingDeque() {
+        Array* array = array_.load(std::memory_order_relaxed);
+        while (array != nullptr) {
+            Array* previous = array->previous;
+            delete array;
+            array = previous;
+        }
+    }
+
+    // Only a snapshot when thieves are active.
+    size_t Size() const {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+    bool Empty() const {
+        return Size() == 0;
+    }
+
+    // Owner only.
+    void Push(T value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+
+        if (bottom - top > array->capacity - 1) {
+            array = Grow(array, bottom, top);
+        }
+
+        array->Put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. Takes the most recently pushed element.
+    bool Pop(T& value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        value = array->Get(bottom);
+        if (top != bottom) {
+            return true;
+        }
+
+        // Last element: race the thieves for it.
+        bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                std::memory_order_relaxed);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    // Any thread. Takes the oldest element; fails on an empty deque or when
+    // another thread won the race for the same element.
+    bool Steal(T& value) {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+        if (top >= bottom) {
+            return false;
+        }
+
+        Array* array = array_.load(std::memory_order_acquire);
+        T stolen = array->Get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return false;
+        }
+
+        value = stolen;
+        return true;
+    }
+};
+
+#endif // WORK_STEALING_DEQUE_H